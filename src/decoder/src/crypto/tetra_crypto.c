@@ -40,8 +40,6 @@
 #include "taa1.h"
 
 
-struct tetra_crypto_database _tcdb, *tcdb = &_tcdb;
-
 static const struct value_string tetra_key_types[] = {
 	{ KEYTYPE_UNDEFINED,		"UNDEFINED" },
 	{ KEYTYPE_CCK_SCK,		"CCK/SCK" },
@@ -90,7 +88,7 @@ const char *tetra_get_security_class_name(uint8_t pdut)
 	return get_value_string(tetra_security_classes, pdut);
 }
 
-void tetra_crypto_state_init(struct tetra_crypto_state *tcs)
+void tetra_crypto_state_init(struct tetra_crypto_state *tcs, struct tetra_crypto_database *tcdb)
 {
 	/* Initialize network info fields to -1 to designate unknown */
 	tcs->mnc = -1;
@@ -103,9 +101,10 @@ void tetra_crypto_state_init(struct tetra_crypto_state *tcs)
 	/* Initialize database key/network pointers to zero */
 	tcs->cck = 0;
 	tcs->network = 0;
+	tcs->tcdb = tcdb;
 }
 
-void tetra_crypto_db_init(void)
+void tetra_crypto_db_init(struct tetra_crypto_database *tcdb)
 {
 	/* Initialize tetra_crypto_database */
 	tcdb->num_keys = 0;
@@ -122,9 +121,16 @@ void tetra_crypto_db_init(void)
 	}
 }
 
+void tetra_crypto_db_free(struct tetra_crypto_database *tcdb)
+{
+	free(tcdb->keys);
+	free(tcdb->nets);
+	memset(tcdb, 0, sizeof(*tcdb));
+}
+
 char *dump_key(struct tetra_key *k)
 {
-	static char pbuf[1024];
+	static __thread char pbuf[1024];
 
 	int c = snprintf(pbuf, sizeof(pbuf), "MCC %4d MNC %4d key_type %s",
 		k->mcc, k->mnc, tetra_get_key_type_name(k->key_type));
@@ -144,7 +150,7 @@ char *dump_key(struct tetra_key *k)
 
 char *dump_network_info(struct tetra_netinfo *network)
 {
-	static char pbuf[1024];
+	static __thread char pbuf[1024];
 	snprintf(pbuf, sizeof(pbuf), "MCC %4d MNC %4d ksg_type %d security_class %d", network->mcc, network->mnc, network->ksg_type, network->security_class);
 	return pbuf;
 }
@@ -259,6 +265,8 @@ bool decrypt_mac_element(struct tetra_crypto_state *tcs, struct tetra_tmvsap_pri
 	/* Apply keystream */
 	for (int i = 0; i < ct_len; i++)
 		ct_start[i] = ct_start[i] ^ ks[i + ks_skip_bits];
+	/* the MAC PDU length may reach past the burst bits */
+	msgb_touch(msg, ct_start + ct_len);
 
 	// printf("tetra_crypto: addr %8d -> key %4d, time %5d/%s, tmpdu offset %d, decrypting %d bits\n",
 		// key->addr, key->index, tcs->hn, tetra_tdma_time_dump(tdma_time), tmpdu_offset, ct_len);
@@ -301,7 +309,7 @@ bool decrypt_voice_timeslot(struct tetra_crypto_state *tcs, struct tetra_tdma_ti
 	return true;
 }
 
-int load_keystore(char *tetra_keyfile)
+int load_keystore(struct tetra_crypto_database *tcdb, char *tetra_keyfile)
 {
 	/* Keystore file:
 	 * Each line contains network or key definition.
@@ -322,7 +330,7 @@ int load_keystore(char *tetra_keyfile)
 	char buf[1000]; // max line len
 	FILE *fp;
 
-	tetra_crypto_db_init();
+	tetra_crypto_db_init(tcdb);
 
 	fp = fopen(tetra_keyfile, "r");
 	if (!fp) {
@@ -396,7 +404,7 @@ int load_keystore(char *tetra_keyfile)
 
 	/* Check network info available for each key and set ptrs for convenience */
 	for (i = 0; i < tcdb->num_keys; i++) {
-		struct tetra_netinfo *network_info_ptr = get_network_info(tcdb->keys[i].mcc, tcdb->keys[i].mnc);
+		struct tetra_netinfo *network_info_ptr = get_network_info(tcdb, tcdb->keys[i].mcc, tcdb->keys[i].mnc);
 		if (!network_info_ptr) {
 			printf("tetra_crypto: Required network info is missing for %4d", tcdb->keys[i].mnc);
 			exit(1);
@@ -410,6 +418,8 @@ int load_keystore(char *tetra_keyfile)
 
 struct tetra_key *get_key_by_addr(struct tetra_crypto_state *tcs, uint32_t addr, enum tetra_key_type key_type)
 {
+	struct tetra_crypto_database *tcdb = tcs->tcdb;
+
 	for (unsigned int i = 0; i < tcdb->num_keys; i++) {
 		struct tetra_key *key = &tcdb->keys[i];
 		if (key->mnc == tcs->mnc &&
@@ -445,6 +455,8 @@ struct tetra_key *get_ksg_key(struct tetra_crypto_state *tcs, int addr)
 
 void update_current_network(struct tetra_crypto_state *tcs, int mcc, int mnc)
 {
+	struct tetra_crypto_database *tcdb = tcs->tcdb;
+
 	/* Update globals */
 	tcs->mcc = mcc;
 	tcs->mnc = mnc;
@@ -465,6 +477,8 @@ void update_current_network(struct tetra_crypto_state *tcs, int mcc, int mnc)
 
 void update_current_cck(struct tetra_crypto_state *tcs)
 {
+	struct tetra_crypto_database *tcdb = tcs->tcdb;
+
 	// printf("\ntetra_crypto: update_current_cck invoked cck %d mcc %d mnc %d\n", tcs->cck_id, tcs->mcc, tcs->mnc);
 	tcs->cck = 0;
 
@@ -481,7 +495,7 @@ void update_current_cck(struct tetra_crypto_state *tcs)
 	}
 }
 
-struct tetra_netinfo *get_network_info(uint32_t mcc, uint32_t mnc)
+struct tetra_netinfo *get_network_info(struct tetra_crypto_database *tcdb, uint32_t mcc, uint32_t mnc)
 {
 	for (unsigned int i = 0; i < tcdb->num_nets; i++) {
 		if (tcdb->nets[i].mcc == mcc && tcdb->nets[i].mnc == mnc)
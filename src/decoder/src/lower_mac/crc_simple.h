@@ -37,12 +37,40 @@ uint16_t crc16_itut_bytes(uint16_t crc,
 			  const uint8_t *input, const int number_bits);
 
 /**
- * Each byte contains one bit. Calculate the CRC16-ITU-T for it.
+ * Each byte contains one bit. Calculate the CRC16-ITU-T for it,
+ * 32 bits at a time with slice-by-4 tables.
  */
 uint16_t crc16_itut_bits(uint16_t crc,
 			 const uint8_t *input, const int number_bits);
 
+/**
+ * Same on a packed bit string (see tetra_pbits.h) starting at bit
+ * 'offs'. The CRC can be carried over, so a string can be fed in parts.
+ */
+uint16_t crc16_itut_pbits(uint16_t crc, const uint64_t *input,
+			  unsigned int offs, int number_bits);
+
+/**
+ * Bit by bit with any polynomial, the reference for the table driven
+ * variants.
+ */
+uint16_t crc16_itut_poly(uint16_t crc, uint32_t poly,
+			 const uint8_t *input, int number_bits);
 
 uint16_t crc16_ccitt_bits(uint8_t *bits, unsigned int len);
 
+/**
+ * The CRC is linear: flipping the bit that has 'dist' more bits after
+ * it in the message XORs the final CRC with this value. Candidate
+ * decodes that differ in a few bits can be checked from the CRC of
+ * one of them.
+ */
+uint16_t crc16_itut_flip(unsigned int dist);
+
+/**
+ * Self-test of the table driven CRCs against the bitwise one,
+ * returns 0 or -1 after printing the first mismatch.
+ */
+int crc16_itut_test(void);
+
 #endif
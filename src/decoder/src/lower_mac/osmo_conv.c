@@ -1,4 +1,5 @@
 #include "osmo_conv.h"
+#include "osmo_conv_simd.h"
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
@@ -18,39 +19,42 @@
 #define BIT2NRZ(REG,N)	(((REG >> N) & 0x01) * 2 - 1) * -1
 #define NUM_STATES(K)	(K == 7 ? 64 : 16)
 
-#define INIT_POINTERS(simd) \
-{ \
-	osmo_conv_metrics_k5_n2 = osmo_conv_##simd##_metrics_k5_n2; \
-	osmo_conv_metrics_k5_n3 = osmo_conv_##simd##_metrics_k5_n3; \
-	osmo_conv_metrics_k5_n4 = osmo_conv_##simd##_metrics_k5_n4; \
-	osmo_conv_metrics_k7_n2 = osmo_conv_##simd##_metrics_k7_n2; \
-	osmo_conv_metrics_k7_n3 = osmo_conv_##simd##_metrics_k7_n3; \
-	osmo_conv_metrics_k7_n4 = osmo_conv_##simd##_metrics_k7_n4; \
-	vdec_malloc = &osmo_conv_##simd##_vdec_malloc; \
-	vdec_free = &osmo_conv_##simd##_vdec_free; \
-}
+#define MAX_NUM_STATES	64
 
-static int init_complete = 0;
+int16_t *osmo_conv_gen_vdec_malloc(size_t n);
+void osmo_conv_gen_vdec_free(int16_t *ptr);
+void osmo_conv_gen_metrics_k5_n2(const int8_t *seq, const int16_t *out,
+	int16_t *sums, int16_t *paths, int norm);
+void osmo_conv_gen_metrics_k5_n3(const int8_t *seq, const int16_t *out,
+	int16_t *sums, int16_t *paths, int norm);
+void osmo_conv_gen_metrics_k5_n4(const int8_t *seq, const int16_t *out,
+	int16_t *sums, int16_t *paths, int norm);
+void osmo_conv_gen_metrics_k7_n2(const int8_t *seq, const int16_t *out,
+	int16_t *sums, int16_t *paths, int norm);
+void osmo_conv_gen_metrics_k7_n3(const int8_t *seq, const int16_t *out,
+	int16_t *sums, int16_t *paths, int norm);
+void osmo_conv_gen_metrics_k7_n4(const int8_t *seq, const int16_t *out,
+	int16_t *sums, int16_t *paths, int norm);
 
 /**
- * These pointers are being initialized at runtime by the
- * osmo_conv_init() depending on supported SIMD extensions.
+ * Kernels used by the decoder. They are set statically, so that decoders
+ * running in parallel threads don't race on a lazy initialization.
  */
-static int16_t *(*vdec_malloc)(size_t n);
-static void (*vdec_free)(int16_t *ptr);
+static int16_t *(*vdec_malloc)(size_t n) = osmo_conv_gen_vdec_malloc;
+static void (*vdec_free)(int16_t *ptr) = osmo_conv_gen_vdec_free;
 
 void (*osmo_conv_metrics_k5_n2)(const int8_t *seq,
-	const int16_t *out, int16_t *sums, int16_t *paths, int norm);
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm) = osmo_conv_gen_metrics_k5_n2;
 void (*osmo_conv_metrics_k5_n3)(const int8_t *seq,
-	const int16_t *out, int16_t *sums, int16_t *paths, int norm);
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm) = osmo_conv_gen_metrics_k5_n3;
 void (*osmo_conv_metrics_k5_n4)(const int8_t *seq,
-	const int16_t *out, int16_t *sums, int16_t *paths, int norm);
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm) = osmo_conv_gen_metrics_k5_n4;
 void (*osmo_conv_metrics_k7_n2)(const int8_t *seq,
-	const int16_t *out, int16_t *sums, int16_t *paths, int norm);
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm) = osmo_conv_gen_metrics_k7_n2;
 void (*osmo_conv_metrics_k7_n3)(const int8_t *seq,
-	const int16_t *out, int16_t *sums, int16_t *paths, int norm);
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm) = osmo_conv_gen_metrics_k7_n3;
 void (*osmo_conv_metrics_k7_n4)(const int8_t *seq,
-	const int16_t *out, int16_t *sums, int16_t *paths, int norm);
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm) = osmo_conv_gen_metrics_k7_n4;
 
 
 
@@ -137,8 +141,7 @@ static void gen_path_metrics(int num_states, int16_t *sums,
 {
 	int i;
 	int16_t min;
-	// int16_t new_sums[num_states];
-	int16_t* new_sums = malloc(2*num_states);
+	int16_t new_sums[MAX_NUM_STATES];
 
 	for (i = 0; i < num_states / 2; i++)
 		acs_butterfly(i, num_states, metrics[i],
@@ -156,7 +159,6 @@ static void gen_path_metrics(int num_states, int16_t *sums,
 	}
 
 	memcpy(sums, new_sums, num_states * sizeof(int16_t));
-	free(new_sums);
 }
 
 /* Not-aligned Memory Allocator */
@@ -258,6 +260,7 @@ struct vtrellis {
  * intrvl    - Normalization interval
  * trellis   - Trellis object
  * paths     - Trellis paths
+ * depunc    - Depuncturing buffer, len * n soft bits
  */
 struct vdecoder {
 	int n;
@@ -267,6 +270,7 @@ struct vdecoder {
 	int intrvl;
 	struct vtrellis trellis;
 	int16_t **paths;
+	int8_t *depunc;
 
 	void (*metric_func)(const int8_t *, const int16_t *,
 		int16_t *, int16_t *, int);
@@ -475,6 +479,21 @@ static void free_trellis(struct vtrellis *trellis)
 	free(trellis->vals);
 }
 
+/* Set the accumulated path metrics to their starting values */
+static void reset_trellis(struct vtrellis *trellis,
+	const struct osmo_conv_code *code)
+{
+	memset(trellis->sums, 0, trellis->num_states * sizeof(int16_t));
+
+	/**
+	 * For termination other than tail-biting, initialize the zero state
+	 * as the encoder starting state. Initialize with the maximum
+	 * accumulated sum at length equal to the constraint length.
+	 */
+	if (code->term != CONV_TERM_TAIL_BITING)
+		trellis->sums[0] = INT8_MAX * code->N * code->K;
+}
+
 /* Initialize the trellis object
  * Initialization consists of generating the outputs and output value of a
  * given state. Due to trellis symmetry and anti-symmetry, only one of the
@@ -514,18 +533,9 @@ static int generate_trellis(struct vdecoder *dec,
 
 		if (rc < 0)
 			goto fail;
-
-		/* Set accumulated path metrics to zero */
-		trellis->sums[i] = 0;
 	}
 
-	/**
-	 * For termination other than tail-biting, initialize the zero state
-	 * as the encoder starting state. Initialize with the maximum
-	 * accumulated sum at length equal to the constraint length.
-	 */
-	if (code->term != CONV_TERM_TAIL_BITING)
-		trellis->sums[0] = INT8_MAX * code->N * code->K;
+	reset_trellis(trellis, code);
 
 	return 0;
 
@@ -624,18 +634,20 @@ static void vdec_deinit(struct vdecoder *dec)
 		vdec_free(dec->paths[0]);
 		free(dec->paths);
 	}
+	free(dec->depunc);
 }
 
 /* Initialize decoder object with code specific params
  * Subtract the constraint length K on the normalization interval to
  * accommodate the initialization path metric at state zero.
  */
-static int vdec_init(struct vdecoder *dec, const struct osmo_conv_code *code)
+static int vdec_init(struct vdecoder *dec, const struct osmo_conv_code *code, int simd)
 {
 	int i, ns, rc;
 
 	ns = NUM_STATES(code->K);
 
+	memset(dec, 0, sizeof(*dec));
 	dec->n = code->N;
 	dec->k = code->K;
 	dec->recursive = conv_code_recursive(code);
@@ -674,6 +686,12 @@ static int vdec_init(struct vdecoder *dec, const struct osmo_conv_code *code)
 		return -EINVAL;
 	}
 
+	if (simd && dec->k == 5) {
+		osmo_conv_metrics_fn simd = osmo_conv_simd_metrics_k5(dec->n);
+		if (simd)
+			dec->metric_func = simd;
+	}
+
 	if (code->term == CONV_TERM_FLUSH)
 		dec->len = code->len + code->K - 1;
 	else
@@ -694,6 +712,10 @@ static int vdec_init(struct vdecoder *dec, const struct osmo_conv_code *code)
 	for (i = 1; i < dec->len; i++)
 		dec->paths[i] = &dec->paths[0][i * ns];
 
+	dec->depunc = (int8_t *) malloc(dec->len * dec->n);
+	if (!dec->depunc)
+		goto enomem;
+
 	return 0;
 
 enomem:
@@ -745,12 +767,9 @@ static void forward_traverse(struct vdecoder *dec, const int8_t *seq)
 static int conv_decode(struct vdecoder *dec, const int8_t *seq,
 	const int *punc, uint8_t *out, int len, int term)
 {
-	int8_t* depunc = malloc(dec->len * dec->n);
-	// int8_t depunc[dec->len * dec->n];
-
 	if (punc) {
-		depuncture(seq, punc, depunc, dec->len * dec->n);
-		seq = depunc;
+		depuncture(seq, punc, dec->depunc, dec->len * dec->n);
+		seq = dec->depunc;
 	}
 
 	/* Propagate through the trellis with interval normalization */
@@ -759,32 +778,21 @@ static int conv_decode(struct vdecoder *dec, const int8_t *seq,
 	if (term == CONV_TERM_TAIL_BITING)
 		forward_traverse(dec, seq);
 
-	free(depunc);
 	return traceback(dec, out, term, len);
 }
 
-static void osmo_conv_init(void)
-{
-	init_complete = 1;
-	INIT_POINTERS(gen);
-}
-
 
-/* All-in-one Viterbi decoding  */
-int osmo_conv_decode_acc(const struct osmo_conv_code *code,
-	const sbit_t *input, ubit_t *output)
+static int decode_acc(const struct osmo_conv_code *code,
+	const sbit_t *input, ubit_t *output, int simd)
 {
 	int rc;
 	struct vdecoder dec;
 
-	if (!init_complete)
-		osmo_conv_init();
-
 	if ((code->N < 2) || (code->N > 4) || (code->len < 1) ||
 		((code->K != 5) && (code->K != 7)))
 		return -EINVAL;
 
-	rc = vdec_init(&dec, code);
+	rc = vdec_init(&dec, code, simd);
 	if (rc)
 		return rc;
 
@@ -796,6 +804,83 @@ int osmo_conv_decode_acc(const struct osmo_conv_code *code,
 	return rc;
 }
 
+/* All-in-one Viterbi decoding  */
+int osmo_conv_decode_acc(const struct osmo_conv_code *code,
+	const sbit_t *input, ubit_t *output)
+{
+	return decode_acc(code, input, output, 1);
+}
+
+/* Same as osmo_conv_decode_acc, but keeps the decoder object for the next
+ * block of the same code and length, only the path metrics are reset */
+int osmo_conv_decode_cached(struct osmo_conv_cache *cache,
+	const struct osmo_conv_code *code,
+	const sbit_t *input, ubit_t *output)
+{
+	struct osmo_conv_cache_entry *e = NULL;
+	int i, rc;
+
+	if ((code->N < 2) || (code->N > 4) || (code->len < 1) ||
+		((code->K != 5) && (code->K != 7)))
+		return osmo_conv_decode(code, input, output);
+
+	for (i = 0; i < cache->num_entries; i++) {
+		e = &cache->entries[i];
+		if (e->next_output == code->next_output &&
+		    e->next_term_output == code->next_term_output &&
+		    e->N == code->N && e->K == code->K &&
+		    e->len == code->len && e->term == code->term)
+			break;
+	}
+
+	if (i < cache->num_entries) {
+		reset_trellis(&e->dec->trellis, code);
+	} else {
+		/* all slots taken, decode without caching */
+		if (cache->num_entries == OSMO_CONV_CACHE_SIZE)
+			return decode_acc(code, input, output, !cache->no_simd);
+
+		e = &cache->entries[cache->num_entries];
+		e->dec = (struct vdecoder *) malloc(sizeof(struct vdecoder));
+		if (!e->dec)
+			return -ENOMEM;
+		rc = vdec_init(e->dec, code, !cache->no_simd);
+		if (rc) {
+			free(e->dec);
+			e->dec = NULL;
+			return rc;
+		}
+		e->next_output = code->next_output;
+		e->next_term_output = code->next_term_output;
+		e->N = code->N;
+		e->K = code->K;
+		e->len = code->len;
+		e->term = code->term;
+		cache->num_entries++;
+	}
+
+	return conv_decode(e->dec, input, code->puncture,
+		output, code->len, code->term);
+}
+
+void osmo_conv_cache_free(struct osmo_conv_cache *cache)
+{
+	int i;
+
+	for (i = 0; i < cache->num_entries; i++) {
+		vdec_deinit(cache->entries[i].dec);
+		free(cache->entries[i].dec);
+	}
+	memset(cache->entries, 0, sizeof(cache->entries));
+	cache->num_entries = 0;
+}
+
+void osmo_conv_cache_set_simd(struct osmo_conv_cache *cache, int enable)
+{
+	osmo_conv_cache_free(cache);
+	cache->no_simd = !enable;
+}
+
 
 void
 osmo_conv_decode_init(struct osmo_conv_decoder *decoder,
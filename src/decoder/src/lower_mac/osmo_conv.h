@@ -75,3 +75,35 @@ int osmo_conv_decode_get_output(struct osmo_conv_decoder *decoder,
 	/* All-in-one */
 int osmo_conv_decode(const struct osmo_conv_code *code,
                      const sbit_t *input, ubit_t *output);
+
+/* Decoder objects kept between blocks, keyed by code and length.
+ * A zeroed struct is an empty cache that uses the SIMD kernels */
+#define OSMO_CONV_CACHE_SIZE 8
+
+struct vdecoder;
+
+struct osmo_conv_cache_entry {
+	const uint8_t (*next_output)[2];
+	const uint8_t *next_term_output;
+	int N;
+	int K;
+	int len;
+	enum osmo_conv_term term;
+	struct vdecoder *dec;
+};
+
+struct osmo_conv_cache {
+	struct osmo_conv_cache_entry entries[OSMO_CONV_CACHE_SIZE];
+	int num_entries;
+	int no_simd;	/* generic metric kernels only */
+};
+
+/* All-in-one, reusing the trellis and path memory from 'cache' */
+int osmo_conv_decode_cached(struct osmo_conv_cache *cache,
+                            const struct osmo_conv_code *code,
+                            const sbit_t *input, ubit_t *output);
+void osmo_conv_cache_free(struct osmo_conv_cache *cache);
+
+/* Enable (default) or disable the SIMD metric kernels of the decoders of one cache,
+ * the cached decoders are dropped */
+void osmo_conv_cache_set_simd(struct osmo_conv_cache *cache, int enable);
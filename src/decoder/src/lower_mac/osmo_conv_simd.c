@@ -0,0 +1,194 @@
+/* SIMD path metric kernels for the K=5 codes (16 states) used by TETRA.
+ *
+ * Same contract as osmo_conv_gen_metrics_k5_n3/n4: 'out' holds 4 NRZ
+ * outputs per state, one butterfly per state pair, paths are stored as
+ * -1/0 and the sums are normalized to a minimum of 0 if 'norm' is set.
+ * All 16 sums fit in two 128-bit registers, so one call is one trellis
+ * stage without any loops.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "osmo_conv_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <emmintrin.h>
+
+#define SSE_TARGET __attribute__((target("sse2")))
+
+/* Branch metrics of the 8 butterflies */
+static inline SSE_TARGET __m128i sse_branch_metrics_k5(const int8_t *seq,
+	const int16_t *out, int n)
+{
+	const __m128i ones = _mm_set1_epi16(1);
+	/* the 4th output is not generated for N=3 codes, so it has to be masked */
+	int16_t s3 = (n == 4) ? seq[3] : 0;
+	__m128i s = _mm_setr_epi16(seq[0], seq[1], seq[2], s3,
+		seq[0], seq[1], seq[2], s3);
+	__m128i p0, p1, p2, p3, lo, hi;
+
+	/* pairwise products of two states per register, then sum the pairs */
+	p0 = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) &out[0]), s);
+	p1 = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) &out[8]), s);
+	p2 = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) &out[16]), s);
+	p3 = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) &out[24]), s);
+
+	lo = _mm_madd_epi16(_mm_packs_epi32(p0, p1), ones);
+	hi = _mm_madd_epi16(_mm_packs_epi32(p2, p3), ones);
+
+	return _mm_packs_epi32(lo, hi);
+}
+
+static inline SSE_TARGET void sse_metrics_k5(const int8_t *seq,
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm, int n)
+{
+	__m128i m, s0, s1, even, odd, sum0, sum1, sum2, sum3, lo, hi, min;
+
+	m = sse_branch_metrics_k5(seq, out, n);
+
+	/* split the sums into the two states of each butterfly */
+	s0 = _mm_loadu_si128((const __m128i *) &sums[0]);
+	s1 = _mm_loadu_si128((const __m128i *) &sums[8]);
+	even = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(s0, 16), 16),
+		_mm_srai_epi32(_mm_slli_epi32(s1, 16), 16));
+	odd = _mm_packs_epi32(_mm_srai_epi32(s0, 16), _mm_srai_epi32(s1, 16));
+
+	/* Add-Compare-Select */
+	sum0 = _mm_add_epi16(even, m);
+	sum1 = _mm_sub_epi16(odd, m);
+	sum2 = _mm_sub_epi16(even, m);
+	sum3 = _mm_add_epi16(odd, m);
+
+	lo = _mm_max_epi16(sum0, sum1);
+	hi = _mm_max_epi16(sum2, sum3);
+
+	_mm_storeu_si128((__m128i *) &paths[0], _mm_cmpeq_epi16(lo, sum0));
+	_mm_storeu_si128((__m128i *) &paths[8], _mm_cmpeq_epi16(hi, sum2));
+
+	if (norm) {
+		min = _mm_min_epi16(lo, hi);
+		min = _mm_min_epi16(min, _mm_shuffle_epi32(min, _MM_SHUFFLE(1, 0, 3, 2)));
+		min = _mm_min_epi16(min, _mm_shuffle_epi32(min, _MM_SHUFFLE(2, 3, 0, 1)));
+		min = _mm_min_epi16(min, _mm_shufflelo_epi16(min, _MM_SHUFFLE(2, 3, 0, 1)));
+		min = _mm_set1_epi16((int16_t) _mm_extract_epi16(min, 0));
+
+		lo = _mm_sub_epi16(lo, min);
+		hi = _mm_sub_epi16(hi, min);
+	}
+
+	_mm_storeu_si128((__m128i *) &sums[0], lo);
+	_mm_storeu_si128((__m128i *) &sums[8], hi);
+}
+
+static SSE_TARGET void osmo_conv_sse_metrics_k5_n3(const int8_t *seq,
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm)
+{
+	sse_metrics_k5(seq, out, sums, paths, norm, 3);
+}
+
+static SSE_TARGET void osmo_conv_sse_metrics_k5_n4(const int8_t *seq,
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm)
+{
+	sse_metrics_k5(seq, out, sums, paths, norm, 4);
+}
+
+osmo_conv_metrics_fn osmo_conv_simd_metrics_k5(int n)
+{
+	if (!__builtin_cpu_supports("sse2"))
+		return NULL;
+
+	switch (n) {
+	case 3:
+		return osmo_conv_sse_metrics_k5_n3;
+	case 4:
+		return osmo_conv_sse_metrics_k5_n4;
+	default:
+		return NULL;
+	}
+}
+
+#elif defined(__ARM_NEON)
+
+#include <arm_neon.h>
+
+static inline void neon_metrics_k5(const int8_t *seq,
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm, int n)
+{
+	int16x8x4_t o;
+	int16x8x2_t s;
+	int16x8_t m, sum0, sum1, sum2, sum3, lo, hi;
+	int16x4_t min;
+
+	/* deinterleave to one register per output bit, one state per lane */
+	o = vld4q_s16(out);
+	m = vmulq_n_s16(o.val[0], seq[0]);
+	m = vmlaq_n_s16(m, o.val[1], seq[1]);
+	m = vmlaq_n_s16(m, o.val[2], seq[2]);
+	/* the 4th output is not generated for N=3 codes */
+	if (n == 4)
+		m = vmlaq_n_s16(m, o.val[3], seq[3]);
+
+	/* val[0] holds the even states, val[1] the odd ones */
+	s = vld2q_s16(sums);
+
+	/* Add-Compare-Select */
+	sum0 = vaddq_s16(s.val[0], m);
+	sum1 = vsubq_s16(s.val[1], m);
+	sum2 = vsubq_s16(s.val[0], m);
+	sum3 = vaddq_s16(s.val[1], m);
+
+	lo = vmaxq_s16(sum0, sum1);
+	hi = vmaxq_s16(sum2, sum3);
+
+	vst1q_s16(&paths[0], vreinterpretq_s16_u16(vcgeq_s16(sum0, sum1)));
+	vst1q_s16(&paths[8], vreinterpretq_s16_u16(vcgeq_s16(sum2, sum3)));
+
+	if (norm) {
+		m = vminq_s16(lo, hi);
+		min = vpmin_s16(vget_low_s16(m), vget_high_s16(m));
+		min = vpmin_s16(min, min);
+		min = vpmin_s16(min, min);
+
+		lo = vsubq_s16(lo, vdupq_lane_s16(min, 0));
+		hi = vsubq_s16(hi, vdupq_lane_s16(min, 0));
+	}
+
+	vst1q_s16(&sums[0], lo);
+	vst1q_s16(&sums[8], hi);
+}
+
+static void osmo_conv_neon_metrics_k5_n3(const int8_t *seq,
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm)
+{
+	neon_metrics_k5(seq, out, sums, paths, norm, 3);
+}
+
+static void osmo_conv_neon_metrics_k5_n4(const int8_t *seq,
+	const int16_t *out, int16_t *sums, int16_t *paths, int norm)
+{
+	neon_metrics_k5(seq, out, sums, paths, norm, 4);
+}
+
+osmo_conv_metrics_fn osmo_conv_simd_metrics_k5(int n)
+{
+	switch (n) {
+	case 3:
+		return osmo_conv_neon_metrics_k5_n3;
+	case 4:
+		return osmo_conv_neon_metrics_k5_n4;
+	default:
+		return NULL;
+	}
+}
+
+#else
+
+osmo_conv_metrics_fn osmo_conv_simd_metrics_k5(int n)
+{
+	(void)n;
+	return NULL;
+}
+
+#endif
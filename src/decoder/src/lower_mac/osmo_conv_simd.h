@@ -0,0 +1,9 @@
+#pragma once
+#include <stdint.h>
+
+typedef void (*osmo_conv_metrics_fn)(const int8_t *seq, const int16_t *out,
+	int16_t *sums, int16_t *paths, int norm);
+
+/* Best K=5 path metric kernel for N=3/4 codes on this CPU (SSE2 or NEON),
+ * NULL if only the generic one can be used */
+osmo_conv_metrics_fn osmo_conv_simd_metrics_k5(int n);
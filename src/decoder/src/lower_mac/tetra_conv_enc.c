@@ -36,7 +36,7 @@
 
 static char *dump_state(struct conv_enc_state *ces)
 {
-	static char pbuf[1024];
+	static __thread char pbuf[1024];
 	snprintf(pbuf, sizeof(pbuf), "%u-%u-%u-%u", ces->delayed[0],
 		ces->delayed[1], ces->delayed[2], ces->delayed[3]);
 	return pbuf;
@@ -250,6 +250,28 @@ int tetra_rcpc_depunct(enum tetra_rcpc_puncturer pu, const uint8_t *in, uint32_t
 	return 0;
 }
 
+int tetra_rcpc_depunct_map(enum tetra_rcpc_puncturer pu, uint32_t len, uint16_t *map)
+{
+	const struct puncturer *punct;
+	uint32_t i, j, k;
+	uint8_t t;
+	const uint8_t *P;
+
+	if (pu >= ARRAY_SIZE(tetra_puncts))
+		return -EINVAL;
+
+	punct = tetra_puncts[pu];
+	t = punct->t;
+	P = punct->P;
+
+	for (j = 1; j <= len; j++) {
+		i = punct->i_func(j);
+		k = punct->period * ((i-1)/t) + P[i - t*((i-1)/t)];
+		map[j-1] = k-1;
+	}
+	return 0;
+}
+
 struct punct_test_param {
 	uint16_t type2_len;
 	uint16_t type3_len;
@@ -30,6 +30,9 @@ int get_punctured_rate(enum tetra_rcpc_puncturer pu, uint8_t *in, uint32_t len,
 /* De-Puncture the 'len' type-3 bits (in) and write mother code to out */
 int tetra_rcpc_depunct(enum tetra_rcpc_puncturer pu, const uint8_t *in, uint32_t len, uint8_t *out);
 
+/* tetra_rcpc_depunct() as a table: mother code index of each of the 'len' type-3 bits */
+int tetra_rcpc_depunct_map(enum tetra_rcpc_puncturer pu, uint32_t len, uint16_t *map);
+
 /* Self-test the puncturing/de-puncturing */
 int tetra_punct_test(void);
 
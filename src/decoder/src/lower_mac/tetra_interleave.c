@@ -58,6 +58,13 @@ void block_deinterleave(uint32_t K, uint32_t a, const uint8_t *in, uint8_t *out)
 	}
 }
 
+void block_deinterleave_map(uint32_t K, uint32_t a, uint16_t *map)
+{
+	uint32_t i;
+	for (i = 1; i <= K; i++)
+		map[i-1] = block_interl_func(K, a, i) - 1;
+}
+
 /* EN 300 395-2 Section 5.5.3 Matrix interleaving (voice */
 void matrix_interleave(uint32_t lines, uint32_t columns,
 			const uint8_t *in, uint8_t *out)
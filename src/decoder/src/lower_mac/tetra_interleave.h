@@ -8,6 +8,8 @@
 
 void block_interleave(uint32_t K, uint32_t a, const uint8_t *in, uint8_t *out);
 void block_deinterleave(uint32_t K, uint32_t a, const uint8_t *in, uint8_t *out);
+/* block_deinterleave() as a table: type-4 index of each of the K type-3 bits */
+void block_deinterleave_map(uint32_t K, uint32_t a, uint16_t *map);
 
 void matrix_interleave(uint32_t lines, uint32_t columns,
 			const uint8_t *in, uint8_t *out);
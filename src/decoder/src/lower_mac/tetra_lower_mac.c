@@ -23,6 +23,12 @@
 #include <string.h>
 // #include <unistd.h>
 #include <errno.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 // #include <linux/limits.h>
 
 // #include <osmocom/core/utils.h>
@@ -37,10 +43,12 @@
 #include <lower_mac/tetra_scramb.h>
 #include <lower_mac/tetra_interleave.h>
 #include <lower_mac/tetra_conv_enc.h>
+#include <lower_mac/tetra_rm3014.h>
 #include <tetra_prim.h>
 #include "tetra_upper_mac.h"
 #include <lower_mac/viterbi.h>
 #include <crypto/tetra_crypto.h>
+#include <tetra_pbits.h>
 
 #include "c-code/channel.h"
 #include "c-code/source.h"
@@ -104,16 +112,94 @@ static const struct tetra_blk_param tetra_blk_param[] = {
 	},
 };
 
-struct tetra_cell_data {
-	uint16_t mcc;
-	uint16_t mnc;
-	uint8_t colour_code;
-	struct tetra_tdma_time time;
+/* type-4 soft bit that is always 0, punctured mother code bits are read from there */
+#define GATHER_ERASURE	511
 
-	uint32_t scramb_init;
-};
+/* For every mother code bit of a 2/3 rate block the type-4 bit it comes from, GATHER_ERASURE
+ * if punctured. Built for all interleaved block types when the MAC state is set up */
+int tetra_lower_mac_init(struct tetra_mac_state *tms)
+{
+	uint16_t deint[432], depunct[432];
+	unsigned int i;
+	int type;
+
+	for (type = 0; type < TETRA_BLK_TYPES; type++) {
+		const struct tetra_blk_param *tbp = &tetra_blk_param[type];
+		uint16_t *map;
+
+		if (!tbp->interleave_a || tms->gather_map[type])
+			continue;
+
+		map = malloc(tbp->type2_bits * 4 * sizeof(*map));
+		if (!map)
+			return -ENOMEM;
+		for (i = 0; i < tbp->type2_bits * 4u; i++)
+			map[i] = GATHER_ERASURE;
+		block_deinterleave_map(tbp->type345_bits, tbp->interleave_a, deint);
+		tetra_rcpc_depunct_map(TETRA_RCPC_PUNCT_2_3, tbp->type345_bits, depunct);
+		for (i = 0; i < tbp->type345_bits; i++)
+			map[depunct[i]] = deint[i];
+		tms->gather_map[type] = map;
+	}
+	return 0;
+}
 
-static struct tetra_cell_data _tcd, *tcd = &_tcd;
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	timespec_get(&ts, TIME_UTC);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* the decode costs are measured on every COST_SAMPLE_INTERVAL-th block of a type, reading
+ * the clock twice per block would cost more than some of the steps it measures */
+#define COST_SAMPLE_INTERVAL	16
+
+/* running average of the cost of a decode step */
+static void update_cost(double *avg, uint64_t start)
+{
+	double ns = (double)(now_ns() - start);
+
+	*avg = *avg ? *avg + (ns - *avg) / 16 : ns;
+}
+
+/* Signalling blocks: sync and AACH keep the TDMA time and the slot classification, the rest
+ * follows the timeslot filter. The talkgroup filter needs the usage marker assignments of the
+ * MAC-RESOURCE PDUs on the MCCH, so timeslot 1 is always parsed when it is set */
+static enum tetra_decode_action get_decode_action(const struct tetra_mac_state *tms,
+						  enum tp_sap_data_type type, uint8_t tn)
+{
+	const struct tetra_decode_policy *pol = &tms->decode_policy;
+
+	if (type == TPSAP_T_SB1 || type == TPSAP_T_SB2 || type == TPSAP_T_BBK)
+		return TETRA_DECODE_FULL;
+	if (pol->num_talkgroups && tn == 1)
+		return TETRA_DECODE_FULL;
+	if (pol->timeslots && !(pol->timeslots & (1 << (tn - 1))))
+		return pol->other_slots;
+	return TETRA_DECODE_FULL;
+}
+
+/* The speech of timeslot 'tn' passes the timeslot, usage marker and talkgroup filters */
+static bool traffic_wanted(const struct tetra_mac_state *tms, uint8_t tn)
+{
+	const struct tetra_decode_policy *pol = &tms->decode_policy;
+	int um = tms->cur_burst.is_traffic;	/* DL usage marker from the AACH */
+	unsigned int i;
+
+	if (pol->timeslots && !(pol->timeslots & (1 << (tn - 1))))
+		return false;
+	if (pol->usage_markers && !(pol->usage_markers & (1ULL << um)))
+		return false;
+	if (!pol->num_talkgroups)
+		return true;
+	for (i = 0; i < pol->num_talkgroups; i++) {
+		if (pol->talkgroups[i] == tms->usage_marker_ssi[um])
+			return true;
+	}
+	return false;
+}
 
 int is_bsch(struct tetra_tdma_time *tm)
 {
@@ -129,14 +215,19 @@ int is_bnch(struct tetra_tdma_time *tm)
 	return 0;
 }
 
-struct tetra_tmvsap_prim *tmvsap_prim_alloc(uint16_t prim, uint8_t op)
+struct tetra_tmvsap_prim *tmvsap_prim_alloc(struct tetra_mac_state *tms, uint16_t prim, uint8_t op)
 {
 	struct tetra_tmvsap_prim *ttp;
 
 	// ttp = talloc_zero(NULL, struct tetra_tmvsap_prim);
-	ttp = malloc(sizeof(struct tetra_tmvsap_prim));
+	if (tms->num_free_prims) {
+		ttp = tms->free_prims[--tms->num_free_prims];
+	} else {
+		ttp = malloc(sizeof(struct tetra_tmvsap_prim));
+		tms->prim_heap_allocs++;
+	}
 	memset(ttp, 0, sizeof(struct tetra_tmvsap_prim));
-	ttp->oph.msg = msgb_alloc(412, "tmvsap_prim");
+	ttp->oph.msg = msgb_pool_alloc(&tms->msgb_pool, 412, "tmvsap_prim");
 	ttp->oph.sap = TETRA_SAP_TMV;
 	ttp->oph.primitive = prim;
 	ttp->oph.operation = op;
@@ -144,18 +235,110 @@ struct tetra_tmvsap_prim *tmvsap_prim_alloc(uint16_t prim, uint8_t op)
 	return ttp;
 }
 
+void tmvsap_prim_free(struct tetra_mac_state *tms, struct tetra_tmvsap_prim *ttp)
+{
+	msgb_pool_release(&tms->msgb_pool, ttp->oph.msg);
+	if (tms->num_free_prims < TMVSAP_PRIM_POOL_SIZE)
+		tms->free_prims[tms->num_free_prims++] = ttp;
+	else
+		free(ttp);
+}
+
+#ifdef TETRA_PACKED_BITS
+/* read a field of the type-1 bits from the packed copy */
+static uint32_t type1_uint(const uint64_t *ptype2, const uint8_t *type2, unsigned int offs, unsigned int len)
+{
+	uint32_t val = pbits_get(ptype2, offs, len);
+
+#ifdef TETRA_PACKED_BITS_VERIFY
+	if (val != bits_to_uint(type2 + offs, len))
+		fprintf(stderr, "packed bits mismatch: type1 bits %u+%u\n", offs, len);
+#endif
+	return val;
+}
+#define TYPE1_UINT(offs, len)	type1_uint(ptype2, type2, offs, len)
+#else
+#define TYPE1_UINT(offs, len)	bits_to_uint(type2 + (offs), len)
+#endif
+
+/* The ETSI codec keeps its state in globals of the downloaded sources, one lock
+ * for the whole process keeps decoders on different threads from racing on it */
+#ifdef _WIN32
+static SRWLOCK codec_lock = SRWLOCK_INIT;
+#define CODEC_LOCK()	AcquireSRWLockExclusive(&codec_lock)
+#define CODEC_UNLOCK()	ReleaseSRWLockExclusive(&codec_lock)
+#else
+static pthread_mutex_t codec_lock = PTHREAD_MUTEX_INITIALIZER;
+#define CODEC_LOCK()	pthread_mutex_lock(&codec_lock)
+#define CODEC_UNLOCK()	pthread_mutex_unlock(&codec_lock)
+#endif
+
+/* Decode one TCH/S block into 480 samples with the ETSI codec. Calls are
+ * serialized, but the synthesis state is still shared: blocks of one stream
+ * have to come in order, and two streams decoding speech at the same time
+ * leak filter state into each other */
+void tetra_speech_decode(int16_t *interleaved_coded_array, bool first_pass, int16_t *synth)
+{
+	int16_t Coded_array[432];
+	int16_t Reordered_array[286];   /* 2 frames vocoder + 8 + 4 */
+
+	CODEC_LOCK();
+	Desinterleaving_Speech(interleaved_coded_array, Coded_array);
+	bool corrupted = Channel_Decoding(first_pass, 0, Coded_array, Reordered_array);
+	int16_t cdecoder_output[276];
+	cdecoder_output[0] = corrupted;
+	for(int i = 0; i < 137; i++) {
+		cdecoder_output[1+i] = Reordered_array[i];
+	}
+	cdecoder_output[138] = corrupted;
+	for(int i = 0; i < 137; i++) {
+		cdecoder_output[139+i] = Reordered_array[137+i];
+	}
+
+	int16_t parm[24];
+	int16_t* synth_p2 = &(synth[240]);
+	int16_t serial[138];
+	for(int i = 0; i < 138; i++) {
+		serial[i] = cdecoder_output[i];
+	}
+	Bits2prm_Tetra(serial, parm);	/* serial to parameters */
+	Decod_Tetra(parm, synth);		/* decoder */
+	Post_Process(synth, (int16_t)240);	/* Post processing of synthesis  */
+	for(int i = 0; i < 138; i++) {
+		serial[i] = cdecoder_output[i+138];
+	}
+	Bits2prm_Tetra(serial, parm);	/* serial to parameters */
+	Decod_Tetra(parm, synth_p2);		/* decoder */
+	Post_Process(synth_p2, (int16_t)240);	/* Post processing of synthesis  */
+	CODEC_UNLOCK();
+}
+
 /* incoming TP-SAP UNITDATA.ind  from PHY into lower MAC */
-void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bits, unsigned int len, void *priv)
+void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bits, const int8_t *sbits, unsigned int len, void *priv)
 {
 	/* various intermediary buffers */
 	uint8_t type4[512];
-	uint8_t type3dp[512*4];
-	uint8_t type3[512];
 	uint8_t type2[512];
+	/* soft-decision counterpart, only used if sbits != NULL */
+	int8_t stype4[512];
+	/* Viterbi input: depunctured mother code, +127 = 0, -127 = 1, 0 = erasure. The
+	 * decoder also reads the 4 flush steps past type2_bits, they stay erasures */
+	int8_t vit_in[(288+4)*4];
+#ifdef TETRA_PACKED_BITS
+	/* packed type-4 and type-2 bits, see tetra_pbits.h */
+	uint64_t ptype4[PBITS_WORDS(512)];
+	uint64_t ptype2[PBITS_WORDS(512)];
+#endif
 
 	const struct tetra_blk_param *tbp = &tetra_blk_param[type];
 	struct tetra_mac_state *tms = priv;
 	struct tetra_crypto_state *tcs = tms->tcs;
+	struct tetra_cell_data *tcd = &tms->cell_data;
+	struct tetra_phy_state *tps = &tms->phy_state;
+	const struct tetra_scramb_seq *seq;
+	enum tetra_decode_action action;
+	bool speech, timed;
+	uint64_t start = 0;
 	const char *time_str;
 
 	/* TMV-SAP.UNITDATA.ind primitive which we will send to the upper MAC */
@@ -164,14 +347,32 @@ void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bi
 
 	struct msgb *msg;
 
-	ttp = tmvsap_prim_alloc(PRIM_TMV_UNITDATA, PRIM_OP_INDICATION);
+	ttp = tmvsap_prim_alloc(tms, PRIM_TMV_UNITDATA, PRIM_OP_INDICATION);
 	tup = &ttp->u.unitdata;
 	msg = ttp->oph.msg;
 
 	/* update the cell time */
-	memcpy(&tcd->time, &t_phy_state.time, sizeof(tcd->time));
+	memcpy(&tcd->time, &tps->time, sizeof(tcd->time));
 	time_str = tetra_tdma_time_dump(&tcd->time);
 
+	/* a full slot of speech carries no signalling, it only goes to the codec */
+	speech = type == TPSAP_T_SCH_F && tms->cur_burst.is_traffic;
+	action = speech ? TETRA_DECODE_SKIP : get_decode_action(tms, type, tcd->time.tn);
+
+	/* Handle block 1 slot stealing, see clause 19.4.4 */
+	/* Block 1 is stolen if AACH says slot is traffic and burst used training sequence 1 */
+	/* Block 2 is stolen if indicated in stolen block 1 resource len (-2) */
+	if (tms->cur_burst.is_traffic && type == TPSAP_T_NDB && blk_num == BLK_1)
+		tms->cur_burst.blk1_stolen = true;
+
+	if (action == TETRA_DECODE_SKIP) {
+		tms->decode_stats.fec_skipped[type]++;
+		if (!speech) {
+			tmvsap_prim_free(tms, ttp);
+			return;
+		}
+	}
+
 	if (type == TPSAP_T_SB2 && is_bnch(&tcd->time)) {
 		tup->lchan = TETRA_LC_BNCH;
 		// printf("BNCH FOLLOWS\n");
@@ -181,41 +382,77 @@ void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bi
 		osmo_ubit_dump(bits, tbp->type345_bits));
 
 	/* De-scramble, pay special attention to SB1 pre-defined scrambling */
-	memcpy(type4, bits, tbp->type345_bits);
 	if (type == TPSAP_T_SB1) {
-		tetra_scramb_bits(SCRAMB_INIT, type4, tbp->type345_bits);
-		tup->scrambling_code = SCRAMB_INIT;
+		seq = &tetra_scramb_seq_sb1;
 	} else {
-		tetra_scramb_bits(tcd->scramb_init, type4, tbp->type345_bits);
-		tup->scrambling_code = tcd->scramb_init;
+		/* filled by the SYNC PDU, this only runs for blocks before the first one */
+		if (tcd->scramb_seq.lfsr_init != tcd->scramb_init)
+			tetra_scramb_seq_init(&tcd->scramb_seq, tcd->scramb_init);
+		seq = &tcd->scramb_seq;
+	}
+	tup->scrambling_code = seq->lfsr_init;
+#ifdef TETRA_PACKED_BITS
+	pbits_pack(ptype4, bits, tbp->type345_bits);
+	tetra_scramb_seq_pbits(seq, ptype4, tbp->type345_bits);
+	/* deinterleaving and the speech codec still want one bit per byte */
+	pbits_unpack(type4, ptype4, 0, tbp->type345_bits);
+#ifdef TETRA_PACKED_BITS_VERIFY
+	{
+		uint8_t ref4[512];
+
+		memcpy(ref4, bits, tbp->type345_bits);
+		tetra_scramb_bits(tup->scrambling_code, ref4, tbp->type345_bits);
+		if (memcmp(ref4, type4, tbp->type345_bits))
+			fprintf(stderr, "packed bits mismatch: %s type4\n", tbp->name);
+	}
+#endif
+#else
+	memcpy(type4, bits, tbp->type345_bits);
+	tetra_scramb_seq_bits(seq, type4, tbp->type345_bits);
+#endif
+	if (sbits) {
+		memcpy(stype4, sbits, tbp->type345_bits);
+		tetra_scramb_seq_sbits(seq, stype4, tbp->type345_bits);
 	}
 
 	DEBUGP("%s %s type4: %s\n", tbp->name, time_str,
 		osmo_ubit_dump(type4, tbp->type345_bits));
 
-	/* Handle block 1 slot stealing, see clause 19.4.4 */
-	/* Block 1 is stolen if AACH says slot is traffic and burst used training sequence 1 */
-	/* Block 2 is stolen if indicated in stolen block 1 resource len (-2) */
-	if (tms->cur_burst.is_traffic && type == TPSAP_T_NDB && blk_num == BLK_1)
-		tms->cur_burst.blk1_stolen = true;
-
-	if (tbp->interleave_a) {
-		/* Run block deinterleaving: type-3 bits */
-		block_deinterleave(tbp->type345_bits, tbp->interleave_a, type4, type3);
-		DEBUGP("%s %s type3: %s\n", tbp->name, time_str,
-			osmo_ubit_dump(type3, tbp->type345_bits));
-		/* De-puncture */
-		memset(type3dp, 0xff, sizeof(type3dp));
-		tetra_rcpc_depunct(TETRA_RCPC_PUNCT_2_3, type3, tbp->type345_bits, type3dp);
-		DEBUGP("%s %s type3dp: %s\n", tbp->name, time_str,
-			osmo_ubit_dump(type3dp, tbp->type2_bits*4));
-		viterbi_dec_sb1_wrapper(type3dp, type2, tbp->type2_bits);
+	timed = action != TETRA_DECODE_SKIP &&
+		tms->decode_stats.fec_run[type] % COST_SAMPLE_INTERVAL == 0;
+	if (timed)
+		start = now_ns();
+	if (tbp->interleave_a && action != TETRA_DECODE_SKIP) {
+		/* Block deinterleaving and de-puncturing in one pass, straight into the Viterbi input */
+		const uint16_t *map = tms->gather_map[type];
+		unsigned int i, mother_bits = tbp->type2_bits * 4;
+
+		if (!sbits) {
+			for (i = 0; i < tbp->type345_bits; i++)
+				stype4[i] = type4[i] ? -127 : 127;
+		}
+		stype4[GATHER_ERASURE] = 0;
+		for (i = 0; i < mother_bits; i++)
+			vit_in[i] = stype4[map[i]];
+		memset(vit_in + mother_bits, 0, 4*4);
+		viterbi_dec_sb1_soft(&tms->conv_cache, vit_in, type2, tbp->type2_bits);
 		DEBUGP("%s %s type2: %s\n", tbp->name, time_str,
 			osmo_ubit_dump(type2, tbp->type2_bits));
 	}
 
-	if (tbp->have_crc16) {
+	if (tbp->have_crc16 && action != TETRA_DECODE_SKIP) {
+#ifdef TETRA_PACKED_BITS
+		uint16_t crc;
+
+		pbits_pack(ptype2, type2, tbp->type2_bits);
+		crc = crc16_itut_pbits(0xffff, ptype2, 0, tbp->type1_bits+16);
+#ifdef TETRA_PACKED_BITS_VERIFY
+		if (crc != crc16_ccitt_bits(type2, tbp->type1_bits+16))
+			fprintf(stderr, "packed bits mismatch: %s crc\n", tbp->name);
+#endif
+#else
 		uint16_t crc = crc16_ccitt_bits(type2, tbp->type1_bits+16);
+#endif
 		// printf("CRC COMP: 0x%04x ", crc);
 		if (crc == TETRA_CRC_OK) {
 			// printf("OK\n");
@@ -223,18 +460,45 @@ void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bi
 			// printf("%s %s type1: %s\n", tbp->name, time_str,
 				// osmo_ubit_dump(type2, tbp->type1_bits));
 			tms->t_display_st->last_crc_fail = false;
+			tms->crc_ok[type]++;
 		} else if(type != TPSAP_T_SCH_F) {
 			// printf("WRONG\n");
 			tms->t_display_st->last_crc_fail = true;
+			tms->crc_fail[type]++;
+		} else if (!tms->cur_burst.is_traffic) {
+			tms->crc_fail[type]++;
 		}
 	} else if (type == TPSAP_T_BBK) {
-		/* FIXME: RM3014-decode */
-		tup->crc_ok = 1;
-		tms->t_display_st->last_crc_fail = false;
-		memcpy(type2, type4, tbp->type2_bits);
+		/* RM(30,14), the error detection stands in for the CRC */
+		uint32_t cw = 0;
+		uint16_t info;
+		unsigned int i;
+		int rc;
+
+		if (sbits) {
+			rc = tetra_rm3014_decode_soft(stype4, &info);
+		} else {
+			for (i = 0; i < tbp->type345_bits; i++)
+				cw = (cw << 1) | type4[i];
+			rc = tetra_rm3014_decode(cw, &info);
+		}
+		for (i = 0; i < tbp->type1_bits; i++)
+			type2[i] = (info >> (tbp->type1_bits - 1 - i)) & 1;
+		if (rc >= 0) {
+			tup->crc_ok = 1;
+			tms->t_display_st->last_crc_fail = false;
+			tms->crc_ok[type]++;
+		} else {
+			tms->t_display_st->last_crc_fail = true;
+			tms->crc_fail[type]++;
+		}
 		DEBUGP("%s %s type1: %s\n", tbp->name, time_str,
 			osmo_ubit_dump(type2, tbp->type1_bits));
 	}
+	if (timed)
+		update_cost(&tms->decode_stats.fec_ns[type], start);
+	if (action != TETRA_DECODE_SKIP)
+		tms->decode_stats.fec_run[type]++;
 
 	/* Set whether BLK1 or BLK2 in downlink burst (or 0 if not applicable) */
 	tup->blk_num = blk_num;
@@ -250,22 +514,24 @@ void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bi
 		// printf("MN %s(%2u) ", osmo_ubit_dump(type2+17, 6), bits_to_uint(type2+17, 6));
 		// printf("MCC %s(%u) ", osmo_ubit_dump(type2+31, 10), bits_to_uint(type2+31, 10));
 		// printf("MNC %s(%u)\n", osmo_ubit_dump(type2+41, 14), bits_to_uint(type2+41, 14));
-		tms->t_display_st->mcc = bits_to_uint(type2+31, 10);
-		tms->t_display_st->mnc = bits_to_uint(type2+41, 14);
-		tms->t_display_st->cc = bits_to_uint(type2+4, 6);
+		tms->t_display_st->mcc = TYPE1_UINT(31, 10);
+		tms->t_display_st->mnc = TYPE1_UINT(41, 14);
+		tms->t_display_st->cc = TYPE1_UINT(4, 6);
 		/* obtain information from SYNC PDU */
 		if (tup->crc_ok) {
-			tcd->colour_code = bits_to_uint(type2+4, 6);
-			tcd->time.tn = bits_to_uint(type2+10, 2) + 1;
-			tcd->time.fn = bits_to_uint(type2+12, 5);
-			tcd->time.mn = bits_to_uint(type2+17, 6);
-			tcd->mcc = bits_to_uint(type2+31, 10);
-			tcd->mnc = bits_to_uint(type2+41, 14);
+			tcd->colour_code = TYPE1_UINT(4, 6);
+			tcd->time.tn = TYPE1_UINT(10, 2) + 1;
+			tcd->time.fn = TYPE1_UINT(12, 5);
+			tcd->time.mn = TYPE1_UINT(17, 6);
+			tcd->mcc = TYPE1_UINT(31, 10);
+			tcd->mnc = TYPE1_UINT(41, 14);
 			/* compute the scrambling code for the current cell */
 			tcd->scramb_init = tetra_scramb_get_init(tcd->mcc, tcd->mnc, tcd->colour_code);
+			if (tcd->scramb_seq.lfsr_init != tcd->scramb_init)
+				tetra_scramb_seq_init(&tcd->scramb_seq, tcd->scramb_init);
 		}
 		/* update the PHY layer time */
-		memcpy(&t_phy_state.time, &tcd->time, sizeof(t_phy_state.time));
+		memcpy(&tps->time, &tcd->time, sizeof(tps->time));
 		tup->lchan = TETRA_LC_BSCH;
 
 		/* Update colour code and network info for crypto IV generation */
@@ -284,32 +550,42 @@ void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bi
 	case TPSAP_T_SCH_F:
 		tup->lchan = TETRA_LC_SCH_F;
 		//Process voice frame
-		if (tms->cur_burst.is_traffic) {
+		if (speech) {
+			/* the first wanted traffic slot of a frame is the one we listen to */
+			bool wanted = traffic_wanted(tms, tps->time.tn);
+			if (wanted && tms->t_display_st->curr_frame != tms->last_frame) {
+				tms->curr_active_timeslot = tps->time.tn;
+				tms->last_frame = tms->t_display_st->curr_frame;
+			}
+			if (!wanted || tms->curr_active_timeslot != tps->time.tn) {
+				tms->decode_stats.codec_skipped++;
+				break;
+			}
+
 			int16_t block[690];
 			/* Generate a block */
 			memset(block, 0x00, sizeof(int16_t) * 690);
 			for (int i = 0; i < 6; i++)
 				block[115*i] = 0x6b21 + i;
    
+			/* The channel decoder takes soft values, hard bits are +-127 */
 			for (int i = 0; i < 114; i++)
-				block[1+i] = type4[i] ? -127 : 127;
+				block[1+i] = sbits ? stype4[i] : (type4[i] ? -127 : 127);
    
 			for (int i = 0; i < 114; i++)
-				block[116+i] = type4[114+i] ? -127 : 127;
+				block[116+i] = sbits ? stype4[114+i] : (type4[114+i] ? -127 : 127);
    
 			for (int i = 0; i < 114; i++)
-				block[231+i] = type4[228+i] ? -127 : 127;
+				block[231+i] = sbits ? stype4[228+i] : (type4[228+i] ? -127 : 127);
    
 			for (int i = 0; i < 90; i++)
-				block[346+i] = type4[342+i] ? -127 : 127;
+				block[346+i] = sbits ? stype4[342+i] : (type4[342+i] ? -127 : 127);
 			
 			//i'm not sure this is legal, but i don't want to make temp files and execute external programs so
 			
 			//decoding the speech using the etsi codec
 			
 			int16_t interleaved_coded_array[432]; /*time-slot length at 7.2 kb/s*/
-			int16_t  Coded_array[432];
-			int16_t  Reordered_array[286];   /* 2 frames vocoder + 8 + 4 */
 			//block1
 			for(int i = 0; i < 114; i++) {
 				interleaved_coded_array[0+i] = block[1+i];
@@ -332,43 +608,22 @@ void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bi
 					interleaved_coded_array[i] = interleaved_coded_array[i] | 0xFF00;
 				}
 			}
-			Desinterleaving_Speech(interleaved_coded_array, Coded_array);
-			bool corrupted = Channel_Decoding(tms->codec_first_pass, 0, Coded_array, Reordered_array);
-			tms->codec_first_pass = false;
-			int16_t cdecoder_output[276];
-			cdecoder_output[0] = corrupted;
-			for(int i = 0; i < 137; i++) {
-				cdecoder_output[1+i] = Reordered_array[i];
-			}
-			cdecoder_output[138] = corrupted;
-			for(int i = 0; i < 137; i++) {
-				cdecoder_output[139+i] = Reordered_array[137+i];
-			}
-			
-			int16_t parm[24];
-			int16_t synth[480];
-			int16_t* synth_p2 = &(synth[240]);
-			int16_t serial[138];
-			for(int i = 0; i < 138; i++) {
-				serial[i] = cdecoder_output[i];
-			}
-			Bits2prm_Tetra(serial, parm);	/* serial to parameters */
-			Decod_Tetra(parm, synth);		/* decoder */
-			Post_Process(synth, (int16_t)240);	/* Post processing of synthesis  */
-			for(int i = 0; i < 138; i++) {
-				serial[i] = cdecoder_output[i+138];
-			}
-			Bits2prm_Tetra(serial, parm);	/* serial to parameters */
-			Decod_Tetra(parm, synth_p2);		/* decoder */
-			Post_Process(synth_p2, (int16_t)240);	/* Post processing of synthesis  */
 			//USE SYNTH
-			if(tms->t_display_st->curr_frame != tms->last_frame) {
-				tms->curr_active_timeslot = t_phy_state.time.tn;
-				tms->last_frame = tms->t_display_st->curr_frame;
-			}
-			if(tms->curr_active_timeslot == t_phy_state.time.tn) {
+			if (tms->put_traffic_block) {
+				/* the owner runs the codec itself, see tetra_speech_decode() */
+				tms->put_traffic_block(tms->put_voice_data_ctx, interleaved_coded_array);
+			} else {
+				int16_t synth[480];
+				timed = tms->decode_stats.codec_run % COST_SAMPLE_INTERVAL == 0;
+				if (timed)
+					start = now_ns();
+				tetra_speech_decode(interleaved_coded_array, tms->codec_first_pass, synth);
+				tms->codec_first_pass = false;
+				if (timed)
+					update_cost(&tms->decode_stats.codec_ns, start);
 				tms->put_voice_data(tms->put_voice_data_ctx, 480, synth);
 			}
+			tms->decode_stats.codec_run++;
 		}
 		break;
 	default:
@@ -380,7 +635,9 @@ void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bi
 	uint32_t offset = 0;
 	uint8_t *orig_head = msg->head; /* The true start of the timeslot */
 	uint8_t *orig_tail = msg->tail; /* The true end of the timeslot */
-	while (offset < (uint32_t) (tbp->type1_bits - 16)) {
+	if (action == TETRA_DECODE_CRC)
+		tms->decode_stats.crc_only++;
+	while (action == TETRA_DECODE_FULL && offset < (uint32_t) (tbp->type1_bits - 16)) {
 		/* send Rx time along with the TMV-UNITDATA.ind primitive */
 		memcpy(&tup->tdma_time, &tcd->time, sizeof(tup->tdma_time));
 
@@ -406,7 +663,6 @@ void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bi
 
 // out:
 	// talloc_free(msg);
-	free(msg);
 	// talloc_free(ttp);
-	free(ttp);
+	tmvsap_prim_free(tms, ttp);
 }
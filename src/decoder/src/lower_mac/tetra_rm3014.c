@@ -20,55 +20,65 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <lower_mac/tetra_rm3014.h>
 
-/* Generator matrix from Section 8.2.3.2  */
-
-static const uint8_t rm_30_14_gen[14][16] = {
-	{ 1, 0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0, 0, 0, 0 },
-	{ 0, 0, 1, 0, 1, 1, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0 },
-	{ 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0 },
-	{ 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0 },
-	{ 1, 0, 0, 1, 1, 0, 0, 0, 0, 0, 1, 1, 1, 0, 1, 0 },
-	{ 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 1, 1, 0, 1, 1, 0 },
-	{ 0, 0, 1, 0, 1, 1, 0, 0, 0, 0, 1, 0, 1, 1, 1, 0 },
-	{ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1 },
-	{ 1, 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1 },
-	{ 0, 1, 0, 0, 0, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1 },
-	{ 0, 0, 1, 0, 0, 0, 0, 1, 1, 0, 1, 0, 1, 1, 0, 1 },
-	{ 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 1 },
-	{ 0, 0, 0, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 1, 1 },
-	{ 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1 }
+/* Generator matrix from Section 8.2.3.2, one row per information bit,
+ * first bit in bit 29: the upper 14 bits are the identity matrix, the
+ * lower 16 the parity part. Constant, so encoding needs no init */
+static const uint32_t rm_30_14_rows[14] = {
+	0x20009b60, 0x10002de0, 0x0800fc20, 0x0400e03c,
+	0x0200983a, 0x01005436, 0x00802c2e, 0x0040ffdf,
+	0x00208339, 0x001042b5, 0x000821ad, 0x00041273,
+	0x0002096b, 0x000104e7,
 };
 
-static uint32_t rm_30_14_rows[14];
+/* The code has a minimum distance of 8, so every pattern of up to 3 bit
+ * errors has its own syndrome. Sorted by syndrome for the lookup */
+#define RM_30_14_PATTERNS	(1 + 30 + 435 + 4060)
 
+struct rm_30_14_corr {
+	uint16_t syndrome;
+	uint32_t error;
+};
+
+static struct rm_30_14_corr rm_30_14_corr[RM_30_14_PATTERNS];
+
+/* least reliable bits flipped by the Chase decoder, 2^n test patterns */
+#define RM_CHASE_BITS	4
 
-static uint32_t shift_bits_together(const uint8_t *bits, int len)
+
+/* parity bits of the received word XOR the parity of its information bits */
+static uint16_t rm3014_syndrome(uint32_t cw)
 {
-	uint32_t ret = 0;
-	int i;
+	return (cw ^ tetra_rm3014_compute(cw >> 16)) & 0xffff;
+}
 
-	for (i = len-1; i >= 0; i--)
-		ret |= bits[i] << (len-1-i);
+static int corr_cmp(const void *a, const void *b)
+{
+	const struct rm_30_14_corr *x = a, *y = b;
 
-	return ret;
+	return (int)x->syndrome - (int)y->syndrome;
 }
 
 void tetra_rm3014_init(void)
 {
-	int i;
-	uint32_t val;
+	int i, j, k, n = 0;
 
-	for (i = 0; i < 14; i++) {
-		/* upper 14 bits identity matrix */
-		val = (1 << (16+13 - i));
-		/* lower 16 bits from rm_30_14_gen */
-		val |= shift_bits_together(rm_30_14_gen[i], 16);
-		rm_30_14_rows[i] = val;
-		// printf("rm_30_14_rows[%u] = 0x%08x\n", i, val);
+	/* all error patterns of weight 0..3 */
+	rm_30_14_corr[n++].error = 0;
+	for (i = 0; i < 30; i++) {
+		rm_30_14_corr[n++].error = 1u << i;
+		for (j = i + 1; j < 30; j++) {
+			rm_30_14_corr[n++].error = (1u << i) | (1u << j);
+			for (k = j + 1; k < 30; k++)
+				rm_30_14_corr[n++].error = (1u << i) | (1u << j) | (1u << k);
+		}
 	}
+	for (i = 0; i < n; i++)
+		rm_30_14_corr[i].syndrome = rm3014_syndrome(rm_30_14_corr[i].error);
+	qsort(rm_30_14_corr, n, sizeof(rm_30_14_corr[0]), corr_cmp);
 }
 
 uint32_t tetra_rm3014_compute(const uint16_t in)
@@ -87,10 +97,166 @@ uint32_t tetra_rm3014_compute(const uint16_t in)
 
 /**
  * This is a systematic code. We can remove the control bits
- * and then check for an error. Maybe correct it in the future.
+ * and then correct the errors the syndrome points to.
  */
 int tetra_rm3014_decode(const uint32_t inp, uint16_t *out)
 {
-	*out = inp >> 16;
+	uint16_t syn = rm3014_syndrome(inp);
+	int lo = 0, hi = RM_30_14_PATTERNS - 1, mid;
+
+	*out = (inp >> 16) & 0x3fff;
+	if (!syn)
+		return 0;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (rm_30_14_corr[mid].syndrome == syn) {
+			*out = ((inp ^ rm_30_14_corr[mid].error) >> 16) & 0x3fff;
+			return __builtin_popcount(rm_30_14_corr[mid].error);
+		}
+		if (rm_30_14_corr[mid].syndrome < syn)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return -1;
+}
+
+/**
+ * Chase-II: decode the hard decision with each combination of its
+ * RM_CHASE_BITS least reliable bits flipped and keep the codeword with
+ * the lowest sum of |soft bit| over the bits it disagrees with. That
+ * sum must stay below 2 bits of average reliability, else the word
+ * counts as undecodable. That keeps random input from decoding about
+ * as rare as with the hard decoder (7%), while fewer blocks are lost
+ * or miscorrected.
+ */
+int tetra_rm3014_decode_soft(const int8_t *sbits, uint16_t *out)
+{
+	unsigned int weak[RM_CHASE_BITS];
+	uint32_t hard = 0, cw, diff;
+	int i, j, n = 0, rel, total = 0, metric, best = -1, best_metric = 0;
+	uint16_t info;
+
+	for (i = 0; i < 30; i++) {
+		hard = (hard << 1) | (sbits[i] < 0);
+		rel = abs(sbits[i]);
+		total += rel;
+		/* insertion into the list of least reliable bits */
+		j = (n < RM_CHASE_BITS) ? n++ : RM_CHASE_BITS;
+		for (; j > 0 && abs(sbits[weak[j-1]]) > rel; j--) {
+			if (j < RM_CHASE_BITS)
+				weak[j] = weak[j-1];
+		}
+		if (j < RM_CHASE_BITS)
+			weak[j] = i;
+	}
+
+	*out = (hard >> 16) & 0x3fff;
+	for (i = 0; i < (1 << RM_CHASE_BITS); i++) {
+		cw = hard;
+		for (j = 0; j < RM_CHASE_BITS; j++) {
+			if (i & (1 << j))
+				cw ^= 1u << (29 - weak[j]);
+		}
+		if (tetra_rm3014_decode(cw, &info) < 0)
+			continue;
+
+		diff = (tetra_rm3014_compute(info) ^ hard) & 0x3fffffff;
+		for (metric = 0, j = 0; j < 30; j++) {
+			if (diff & (1u << (29 - j)))
+				metric += abs(sbits[j]);
+		}
+		if (best < 0 || metric < best_metric) {
+			best = __builtin_popcount(diff);
+			best_metric = metric;
+			*out = info;
+		}
+	}
+
+	if (best < 0 || best_metric * 15 >= total) {
+		*out = (hard >> 16) & 0x3fff;
+		return -1;
+	}
+	return best;
+}
+
+static uint32_t rm_test_rand(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+	return *state >> 16;
+}
+
+/* 'weight' different random bit positions of a 30 bit word */
+static uint32_t rm_test_errors(uint32_t *state, int weight)
+{
+	uint32_t err = 0;
+
+	while (__builtin_popcount(err) < weight)
+		err |= 1u << (rm_test_rand(state) % 30);
+	return err;
+}
+
+int tetra_rm3014_test(void)
+{
+	uint32_t rnd = 1, cw, err;
+	uint16_t info, out;
+	int8_t sbits[30];
+	int i, j, w, rc;
+
+	for (i = 0; i < 1000; i++) {
+		info = rm_test_rand(&rnd) & 0x3fff;
+		cw = tetra_rm3014_compute(info);
+
+		/* up to 3 errors are corrected, 4 always detected */
+		for (w = 0; w <= 4; w++) {
+			err = rm_test_errors(&rnd, w);
+			rc = tetra_rm3014_decode(cw ^ err, &out);
+			if (w < 4 && (rc != w || out != info)) {
+				fprintf(stderr, "rm3014: %d errors 0x%08x in 0x%08x not corrected\n", w, err, cw);
+				return -1;
+			}
+			if (w == 4 && rc != -1) {
+				fprintf(stderr, "rm3014: 4 errors 0x%08x in 0x%08x not detected\n", err, cw);
+				return -1;
+			}
+		}
+
+		/* soft: up to 3 errors on unreliable bits, and the 4 least
+		 * reliable bits wrong, beyond the hard decoder */
+		for (w = 0; w <= 4; w++) {
+			err = rm_test_errors(&rnd, w);
+			for (j = 0; j < 30; j++) {
+				int bit = (cw >> (29 - j)) & 1;
+				int rel = (err & (1u << (29 - j))) ? 10 : 100;
+
+				if (err & (1u << (29 - j)))
+					bit ^= 1;
+				sbits[j] = bit ? -rel : rel;
+			}
+			rc = tetra_rm3014_decode_soft(sbits, &out);
+			if (rc != w || out != info) {
+				fprintf(stderr, "rm3014: %d weak errors 0x%08x in 0x%08x not corrected by the soft decoder\n", w, err, cw);
+				return -1;
+			}
+		}
+
+		/* strong errors: one is corrected, three are too unlikely
+		 * and rejected */
+		for (w = 1; w <= 3; w += 2) {
+			err = rm_test_errors(&rnd, w);
+			for (j = 0; j < 30; j++) {
+				int bit = ((cw ^ err) >> (29 - j)) & 1;
+
+				sbits[j] = bit ? -100 : 100;
+			}
+			rc = tetra_rm3014_decode_soft(sbits, &out);
+			if ((w == 1 && (rc != 1 || out != info)) || (w == 3 && rc != -1)) {
+				fprintf(stderr, "rm3014: soft decoder returned %d for %d strong errors 0x%08x in 0x%08x\n", rc, w, err, cw);
+				return -1;
+			}
+		}
+	}
 	return 0;
 }
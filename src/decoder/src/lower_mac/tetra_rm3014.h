@@ -3,14 +3,35 @@
 
 #include <stdint.h>
 
+/**
+ * Build the syndrome table of the decoders. Rewrites a global table, so
+ * it must run once before any decoder starts and never again while one
+ * runs.
+ */
 void tetra_rm3014_init(void);
+/* encode 14 information bits, works without tetra_rm3014_init() */
 uint32_t tetra_rm3014_compute(const uint16_t in);
 
 /**
- * Decode @param inp to @param out and return if there was
- * an error in the input. In the future this should correct
- * the error or such.
+ * Decode the 30 bit codeword @param inp (first bit in bit 29) to the
+ * 14 information bits in @param out. Up to 3 bit errors are corrected,
+ * returns their number or -1 if the word has more. @param out then
+ * holds the uncorrected information bits. Needs tetra_rm3014_init().
+ */
+int tetra_rm3014_decode(const uint32_t inp, uint16_t *out);
+
+/**
+ * Same for 30 soft bits (+127 = 0, -127 = 1) with Chase decoding,
+ * corrects more errors if they sit on unreliable bits. Returns the
+ * number of corrected hard decisions or -1.
+ */
+int tetra_rm3014_decode_soft(const int8_t *sbits, uint16_t *out);
+
+/**
+ * Self-test of the encoder and both decoders on random words with 0 to
+ * 4 bit errors, returns 0 or -1 after printing the first failure.
+ * Needs tetra_rm3014_init().
  */
-int tetra_rm3013_decode(const uint32_t inp, uint16_t *out);
+int tetra_rm3014_test(void);
 
 #endif
@@ -21,6 +21,7 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include <lower_mac/tetra_scramb.h>
 
 /* Tap macro for the standard XOR / Fibonacci form */
@@ -84,6 +85,102 @@ int tetra_scramb_bits(uint32_t lfsr_init, uint8_t *out, int len)
 	return 0;
 }
 
+/* Same for soft bits (+127 = 0, -127 = 1): invert the sign where the LFSR bit is 1 */
+int tetra_scramb_sbits(uint32_t lfsr_init, int8_t *out, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (next_lfsr_bit(&lfsr_init))
+			out[i] = -out[i];
+	}
+
+	return 0;
+}
+
+/* The taps of next_lfsr_bit() as a mask, the feedback bit is their parity */
+#define LFSR_TAPS	0xdb710641
+
+/* Same on a packed bit string, the LFSR output is collected into whole words */
+int tetra_scramb_pbits(uint32_t lfsr_init, uint64_t *out, int len)
+{
+	uint32_t lfsr = lfsr_init;
+	uint32_t bit;
+	int i, j, n;
+	uint64_t w;
+
+	for (i = 0; i < len; i += 64) {
+		n = (len - i < 64) ? len - i : 64;
+		w = 0;
+		for (j = 0; j < n; j++) {
+			bit = __builtin_parity(lfsr & LFSR_TAPS);
+			lfsr = (lfsr >> 1) | (bit << 31);
+			w = (w << 1) | bit;
+		}
+		out[i / 64] ^= w << (64 - n);
+	}
+
+	return 0;
+}
+
+/* The BSCH uses the same code in every cell, so its sequence is a constant */
+const struct tetra_scramb_seq tetra_scramb_seq_sb1 = {
+	.lfsr_init = SCRAMB_INIT,
+	.bits = {
+		1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 0, 1,
+		1, 0, 0, 1, 1, 0, 1, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1,
+		1, 0, 1, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 1, 1, 0, 1, 0, 1, 0, 0, 0, 1, 1,
+		1, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1,
+		1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0, 1, 1, 1, 0, 0, 1,
+	},
+	.pbits = { 0xbff4f19ac047a2aeULL, 0xa3a2f02fbf4ab900ULL },
+};
+
+void tetra_scramb_seq_init(struct tetra_scramb_seq *seq, uint32_t lfsr_init)
+{
+	int i;
+
+	seq->lfsr_init = lfsr_init;
+	tetra_scramb_get_bits(lfsr_init, seq->bits, TETRA_SCRAMB_SEQ_BITS);
+	memset(seq->pbits, 0, sizeof(seq->pbits));
+	for (i = 0; i < TETRA_SCRAMB_SEQ_BITS; i++)
+		seq->pbits[i / 64] |= (uint64_t)seq->bits[i] << (63 - i % 64);
+}
+
+void tetra_scramb_seq_bits(const struct tetra_scramb_seq *seq, uint8_t *out, int len)
+{
+	uint64_t a, b;
+	int i;
+
+	/* eight bits per XOR */
+	for (i = 0; i + 8 <= len; i += 8) {
+		memcpy(&a, out + i, 8);
+		memcpy(&b, seq->bits + i, 8);
+		a ^= b;
+		memcpy(out + i, &a, 8);
+	}
+	for (; i < len; i++)
+		out[i] ^= seq->bits[i];
+}
+
+void tetra_scramb_seq_sbits(const struct tetra_scramb_seq *seq, int8_t *out, int len)
+{
+	int i;
+
+	/* branch free negation, (x ^ -1) + 1 = -x */
+	for (i = 0; i < len; i++)
+		out[i] = (out[i] ^ -(int8_t)seq->bits[i]) + seq->bits[i];
+}
+
+void tetra_scramb_seq_pbits(const struct tetra_scramb_seq *seq, uint64_t *out, int len)
+{
+	int i;
+
+	/* bits past 'len' in the last word are don't care */
+	for (i = 0; i < (len + 63) / 64; i++)
+		out[i] ^= seq->pbits[i];
+}
+
 uint32_t tetra_scramb_get_init(uint16_t mcc, uint16_t mnc, uint8_t colour)
 {
 	uint32_t scramb_init;
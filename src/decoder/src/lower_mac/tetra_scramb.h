@@ -13,6 +13,20 @@
  */
 #define SCRAMB_INIT	3
 
+/* Longest scrambled block (SCH/F, TCH/S) */
+#define TETRA_SCRAMB_SEQ_BITS	432
+
+/* Precomputed scrambling sequence of one code. Shorter blocks use its
+ * start, so one sequence serves every block length of the cell */
+struct tetra_scramb_seq {
+	uint32_t lfsr_init;				/* 0 if not filled yet */
+	uint8_t bits[TETRA_SCRAMB_SEQ_BITS];		/* one bit per byte */
+	uint64_t pbits[(TETRA_SCRAMB_SEQ_BITS + 63) / 64];	/* packed, see tetra_pbits.h */
+};
+
+/* Sequence of SCRAMB_INIT for the SB1 block, only its first 120 bits are set */
+extern const struct tetra_scramb_seq tetra_scramb_seq_sb1;
+
 uint32_t tetra_scramb_get_init(uint16_t mcc, uint16_t mnc, uint8_t colour);
 
 int tetra_scramb_get_bits(uint32_t lfsr_init, uint8_t *out, int len);
@@ -20,4 +34,19 @@ int tetra_scramb_get_bits(uint32_t lfsr_init, uint8_t *out, int len);
 /* XOR the bitstring at 'out/len' using the TETRA scrambling LFSR */
 int tetra_scramb_bits(uint32_t lfsr_init, uint8_t *out, int len);
 
+/* Same for soft bits (+127 = 0, -127 = 1): invert the sign where the LFSR bit is 1 */
+int tetra_scramb_sbits(uint32_t lfsr_init, int8_t *out, int len);
+
+/* Same for a packed bit string (see tetra_pbits.h) */
+int tetra_scramb_pbits(uint32_t lfsr_init, uint64_t *out, int len);
+
+/* Run the LFSR once and store the sequence of 'lfsr_init' in 'seq' */
+void tetra_scramb_seq_init(struct tetra_scramb_seq *seq, uint32_t lfsr_init);
+
+/* tetra_scramb_bits(), tetra_scramb_sbits() and tetra_scramb_pbits() with a
+ * precomputed sequence, 'len' up to TETRA_SCRAMB_SEQ_BITS */
+void tetra_scramb_seq_bits(const struct tetra_scramb_seq *seq, uint8_t *out, int len);
+void tetra_scramb_seq_sbits(const struct tetra_scramb_seq *seq, int8_t *out, int len);
+void tetra_scramb_seq_pbits(const struct tetra_scramb_seq *seq, uint64_t *out, int len);
+
 #endif /* TETRA_SCRAMB_H */
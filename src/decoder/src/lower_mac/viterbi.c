@@ -3,7 +3,7 @@
 
 #include <lower_mac/viterbi_cch.h>
 
-void viterbi_dec_sb1_wrapper(const uint8_t *in, uint8_t *out, unsigned int sym_count)
+void viterbi_dec_sb1_wrapper(struct osmo_conv_cache *cache, const uint8_t *in, uint8_t *out, unsigned int sym_count)
 {
 	int8_t vit_inp[864*4] = {0};
 	unsigned int i;
@@ -21,5 +21,10 @@ void viterbi_dec_sb1_wrapper(const uint8_t *in, uint8_t *out, unsigned int sym_c
 			break;
 		}
 	}
-	conv_cch_decode(vit_inp, out, sym_count);
+	conv_cch_decode_cached(cache, vit_inp, out, sym_count);
+}
+
+void viterbi_dec_sb1_soft(struct osmo_conv_cache *cache, int8_t *in, uint8_t *out, unsigned int sym_count)
+{
+	conv_cch_decode_cached(cache, in, out, sym_count);
 }
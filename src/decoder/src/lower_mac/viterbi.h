@@ -1,6 +1,14 @@
 #ifndef VITERBI_H
 #define VITERBI_H
 
-void viterbi_dec_sb1_wrapper(const uint8_t *in, uint8_t *out, unsigned int sym_count);
+#include <stdint.h>
+
+struct osmo_conv_cache;
+
+/* 'cache' holds the decoder objects of the calling decoder instance */
+void viterbi_dec_sb1_wrapper(struct osmo_conv_cache *cache, const uint8_t *in, uint8_t *out, unsigned int sym_count);
+
+/* Soft-decision variant: 'in' holds depunctured soft bits (+127 = 0, -127 = 1, 0 = erasure) */
+void viterbi_dec_sb1_soft(struct osmo_conv_cache *cache, int8_t *in, uint8_t *out, unsigned int sym_count);
 
 #endif /* VITERBI_H */
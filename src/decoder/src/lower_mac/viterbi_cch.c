@@ -65,3 +65,13 @@ int conv_cch_decode(int8_t *input, uint8_t *output, int n)
 
 	return osmo_conv_decode(&code, input, output);
 }
+
+int conv_cch_decode_cached(struct osmo_conv_cache *cache, int8_t *input, uint8_t *output, int n)
+{
+	struct osmo_conv_code code;
+
+	memcpy(&code, &conv_cch, sizeof(struct osmo_conv_code));
+	code.len = n;
+
+	return osmo_conv_decode_cached(cache, &code, input, output);
+}
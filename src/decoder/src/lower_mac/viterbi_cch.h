@@ -4,4 +4,8 @@
 int conv_cch_encode(uint8_t *input, uint8_t *output, int n);
 int conv_cch_decode(int8_t *input, uint8_t *output, int n);
 
+struct osmo_conv_cache;
+/* same as conv_cch_decode, reusing the decoder objects from 'cache' */
+int conv_cch_decode_cached(struct osmo_conv_cache *cache, int8_t *input, uint8_t *output, int n);
+
 #endif /* VITERBI_CCH_H */
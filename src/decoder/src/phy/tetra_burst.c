@@ -268,105 +268,110 @@ int build_norm_c_d_burst(uint8_t *buf, const uint8_t *bkn1, const uint8_t *bb, c
 	return (int)(cur - buf);
 }
 
-int tetra_find_train_seq(const uint8_t *in, unsigned int end_of_in,
-			 uint32_t mask_of_train_seq, unsigned int *offset)
-{
-	static uint32_t tsq_bytes[5];
-
-	if (tsq_bytes[0] == 0) {
-#define FILTER_LOOKAHEAD_LEN 22
-#define FILTER_LOOKAHEAD_MASK ((1<<FILTER_LOOKAHEAD_LEN)-1)
-		for (int i = 0; i < FILTER_LOOKAHEAD_LEN; i++) {
-			tsq_bytes[0] = (tsq_bytes[0] << 1) | y_bits[i];
-			tsq_bytes[1] = (tsq_bytes[1] << 1) | n_bits[i];
-			tsq_bytes[2] = (tsq_bytes[2] << 1) | p_bits[i];
-			tsq_bytes[3] = (tsq_bytes[3] << 1) | q_bits[i];
-			tsq_bytes[4] = (tsq_bytes[4] << 1) | x_bits[i];
-		}
-	}
+/* Training sequences in search priority order */
+static const struct {
+	enum tetra_train_seq type;
+	const uint8_t *bits;
+	unsigned int len;
+} train_seqs[] = {
+	{ TETRA_TRAIN_SYNC,	y_bits, sizeof(y_bits) },
+	{ TETRA_TRAIN_NORM_1,	n_bits, sizeof(n_bits) },
+	{ TETRA_TRAIN_NORM_2,	p_bits, sizeof(p_bits) },
+	{ TETRA_TRAIN_NORM_3,	q_bits, sizeof(q_bits) },
+	{ TETRA_TRAIN_EXT,	x_bits, sizeof(x_bits) },
+};
+#define NUM_TRAIN_SEQS	(sizeof(train_seqs)/sizeof(train_seqs[0]))
 
-	uint32_t filter = 0;
+void tetra_burst_train_det_init(struct tetra_train_det *det, uint32_t mask_of_train_seq,
+				unsigned int max_errors)
+{
+	unsigned int i;
 
-	for (int i = 0; i < FILTER_LOOKAHEAD_LEN-2; i++)
-		filter = (filter << 1) | in[i];
+	tetra_train_det_init(det, max_errors);
+	for (i = 0; i < NUM_TRAIN_SEQS; i++) {
+		if (mask_of_train_seq & (1 << train_seqs[i].type))
+			tetra_train_det_add(det, train_seqs[i].type, train_seqs[i].bits, train_seqs[i].len);
+	}
+}
 
-	const uint8_t *cur;
+int tetra_find_train_seq_tol(const uint8_t *in, unsigned int end_of_in,
+			     uint32_t mask_of_train_seq, unsigned int max_errors,
+			     unsigned int *offset)
+{
+	struct tetra_train_det det;
+	int type;
 
-	for (cur = in; cur < in + end_of_in; cur++) {
-		filter = ((filter << 1) | cur[FILTER_LOOKAHEAD_LEN-1]) & FILTER_LOOKAHEAD_MASK;
+	tetra_burst_train_det_init(&det, mask_of_train_seq, max_errors);
+	tetra_train_det_feed(&det, in, end_of_in, &type);
+	if (type < 0)
+		return -1;
 
-		int match = 0;
+	*offset = det.match_bitnum;
+	return type;
+}
 
-		for (int i = 0; i < 5; i++)
-			if (filter == tsq_bytes[i])
-				match = 1;
+int tetra_find_train_seq(const uint8_t *in, unsigned int end_of_in,
+			 uint32_t mask_of_train_seq, unsigned int *offset)
+{
+	return tetra_find_train_seq_tol(in, end_of_in, mask_of_train_seq, 0, offset);
+}
 
-		if (!match)
-			continue;
+int tetra_match_train_seq(const uint8_t *in, unsigned int end_of_in,
+			  uint32_t mask_of_train_seq, unsigned int offset,
+			  unsigned int max_errors)
+{
+	struct tetra_train_det det;
 
-		unsigned remain_len = (unsigned int)((in + end_of_in) - cur);
+	if (offset >= end_of_in)
+		return -1;
 
-		if (mask_of_train_seq & (1 << TETRA_TRAIN_SYNC) &&
-		    remain_len >= sizeof(y_bits) &&
-		    !memcmp(cur, y_bits, sizeof(y_bits))) {
-			*offset = (unsigned int)(cur - in);
-			return TETRA_TRAIN_SYNC;
-		}
-		if (mask_of_train_seq & (1 << TETRA_TRAIN_NORM_1) &&
-		    remain_len >= sizeof(n_bits) &&
-		    !memcmp(cur, n_bits, sizeof(n_bits))) {
-			*offset = (unsigned int)(cur - in);
-			return TETRA_TRAIN_NORM_1;
-		}
-		if (mask_of_train_seq & (1 << TETRA_TRAIN_NORM_2) &&
-		    remain_len >= sizeof(p_bits) &&
-		    !memcmp(cur, p_bits, sizeof(p_bits))) {
-			*offset = (unsigned int)(cur - in);
-			return TETRA_TRAIN_NORM_2;
-		}
-		if (mask_of_train_seq & (1 << TETRA_TRAIN_NORM_3) &&
-		    remain_len >= sizeof(q_bits) &&
-		    !memcmp(cur, q_bits, sizeof(q_bits))) {
-			*offset = (unsigned int)(cur - in);
-			return TETRA_TRAIN_NORM_3;
-		}
-		if (mask_of_train_seq & (1 << TETRA_TRAIN_EXT) &&
-		    remain_len >= sizeof(x_bits) &&
-		    !memcmp(cur, x_bits, sizeof(x_bits))) {
-			*offset = (unsigned int)(cur - in);
-			return TETRA_TRAIN_EXT;
-		}
-	}
-	return -1;
+	tetra_burst_train_det_init(&det, mask_of_train_seq, max_errors);
+	return tetra_train_det_match(&det, in + offset, end_of_in - offset);
 }
 
-void tetra_burst_rx_cb(const uint8_t *burst, unsigned int len, enum tetra_train_seq type, void *priv)
+void tetra_burst_rx_cb(const uint8_t *burst, const int8_t *sburst, unsigned int len, enum tetra_train_seq type, void *priv)
 {
 	uint8_t bbk_buf[NDB_BBK_BITS];
 	uint8_t ndbf_buf[2*NDB_BLK_BITS];
+	int8_t sbbk_buf[NDB_BBK_BITS];
+	int8_t sndbf_buf[2*NDB_BLK_BITS];
+	const int8_t *sbbk = NULL, *sndbf = NULL;
 	struct tetra_mac_state *tms = priv;
+	const struct tetra_tdma_time *time = &tms->phy_state.time;
 	
-	tms->t_display_st->curr_multiframe = t_phy_state.time.mn;
-	tms->t_display_st->curr_frame = t_phy_state.time.fn;
+	tms->t_display_st->curr_multiframe = time->mn;
+	tms->t_display_st->curr_frame = time->fn;
+
+	if (sburst) {
+		/* re-combine the soft broadcast block and SCH/F the same way as the hard bits below */
+		memcpy(sbbk_buf, sburst+NDB_BBK1_OFFSET, NDB_BBK1_BITS);
+		memcpy(sbbk_buf+NDB_BBK1_BITS, sburst+NDB_BBK2_OFFSET, NDB_BBK2_BITS);
+		memcpy(sndbf_buf, sburst+NDB_BLK1_OFFSET, NDB_BLK_BITS);
+		memcpy(sndbf_buf+NDB_BLK_BITS, sburst+NDB_BLK2_OFFSET, NDB_BLK_BITS);
+		sbbk = sbbk_buf;
+		sndbf = sndbf_buf;
+	}
+
+#define SOFT_PART(offs)	(sburst ? sburst+(offs) : NULL)
 
 	switch (type) {
 	case TETRA_TRAIN_SYNC:
 		/* Split SB1, SB2 and Broadcast Block */
 		/* send three parts of the burst via TP-SAP into lower MAC */
-		tp_sap_udata_ind(TPSAP_T_SB1, BLK_1, burst+SB_BLK1_OFFSET, SB_BLK1_BITS, priv);
-		tp_sap_udata_ind(TPSAP_T_BBK, 0,     burst+SB_BBK_OFFSET, SB_BBK_BITS, priv);
-		tp_sap_udata_ind(TPSAP_T_SB2, BLK_2, burst+SB_BLK2_OFFSET, SB_BLK2_BITS, priv);
-		tms->t_display_st->timeslot_content[t_phy_state.time.tn-1] = 3;
+		tp_sap_udata_ind(TPSAP_T_SB1, BLK_1, burst+SB_BLK1_OFFSET, SOFT_PART(SB_BLK1_OFFSET), SB_BLK1_BITS, priv);
+		tp_sap_udata_ind(TPSAP_T_BBK, 0,     burst+SB_BBK_OFFSET, SOFT_PART(SB_BBK_OFFSET), SB_BBK_BITS, priv);
+		tp_sap_udata_ind(TPSAP_T_SB2, BLK_2, burst+SB_BLK2_OFFSET, SOFT_PART(SB_BLK2_OFFSET), SB_BLK2_BITS, priv);
+		tms->t_display_st->timeslot_content[time->tn-1] = 3;
 		break;
 	case TETRA_TRAIN_NORM_2:
 		/* re-combine the broadcast block */
 		memcpy(bbk_buf, burst+NDB_BBK1_OFFSET, NDB_BBK1_BITS);
 		memcpy(bbk_buf+NDB_BBK1_BITS, burst+NDB_BBK2_OFFSET, NDB_BBK2_BITS);
 		/* send three parts of the burst via TP-SAP into lower MAC */
-		tp_sap_udata_ind(TPSAP_T_BBK, 0, bbk_buf, NDB_BBK_BITS, priv);
-		tp_sap_udata_ind(TPSAP_T_NDB, BLK_1, burst+NDB_BLK1_OFFSET, NDB_BLK_BITS, priv);
-		tp_sap_udata_ind(TPSAP_T_NDB, BLK_2, burst+NDB_BLK2_OFFSET, NDB_BLK_BITS, priv);
-		tms->t_display_st->timeslot_content[t_phy_state.time.tn-1] = 2;
+		tp_sap_udata_ind(TPSAP_T_BBK, 0, bbk_buf, sbbk, NDB_BBK_BITS, priv);
+		tp_sap_udata_ind(TPSAP_T_NDB, BLK_1, burst+NDB_BLK1_OFFSET, SOFT_PART(NDB_BLK1_OFFSET), NDB_BLK_BITS, priv);
+		tp_sap_udata_ind(TPSAP_T_NDB, BLK_2, burst+NDB_BLK2_OFFSET, SOFT_PART(NDB_BLK2_OFFSET), NDB_BLK_BITS, priv);
+		tms->t_display_st->timeslot_content[time->tn-1] = 2;
 		break;
 	case TETRA_TRAIN_NORM_1:
 		/* re-combine the broadcast block */
@@ -376,18 +381,20 @@ void tetra_burst_rx_cb(const uint8_t *burst, unsigned int len, enum tetra_train_
 		memcpy(ndbf_buf, burst+NDB_BLK1_OFFSET, NDB_BLK_BITS);
 		memcpy(ndbf_buf+NDB_BLK_BITS, burst+NDB_BLK2_OFFSET, NDB_BLK_BITS);
 		/* send two parts of the burst via TP-SAP into lower MAC */
-		tp_sap_udata_ind(TPSAP_T_BBK, 0, bbk_buf, NDB_BBK_BITS, priv);
-		tp_sap_udata_ind(TPSAP_T_SCH_F, 0, ndbf_buf, 2*NDB_BLK_BITS, priv);
+		tp_sap_udata_ind(TPSAP_T_BBK, 0, bbk_buf, sbbk, NDB_BBK_BITS, priv);
+		tp_sap_udata_ind(TPSAP_T_SCH_F, 0, ndbf_buf, sndbf, 2*NDB_BLK_BITS, priv);
 		if(!tms->cur_burst.is_traffic) {
-			tms->t_display_st->timeslot_content[t_phy_state.time.tn-1] = 1;
+			tms->t_display_st->timeslot_content[time->tn-1] = 1;
 		} else {
-			tms->t_display_st->timeslot_content[t_phy_state.time.tn-1] = 4;
+			tms->t_display_st->timeslot_content[time->tn-1] = 4;
 		}
 		break;
 	case TETRA_TRAIN_NORM_3:
 	case TETRA_TRAIN_EXT:
 		/* uplink training sequences, should not be encountered, ignore */
-		tms->t_display_st->timeslot_content[t_phy_state.time.tn-1] = 0;
+		tms->t_display_st->timeslot_content[time->tn-1] = 0;
 		break;
 	}
+
+#undef SOFT_PART
 }
@@ -2,6 +2,7 @@
 #define TETRA_BURST_H
 
 #include <stdint.h>
+#include <phy/tetra_train_det.h>
 
 #define BLK_1 1
 #define BLK_2 2
@@ -15,7 +16,8 @@ enum tp_sap_data_type {
 	TPSAP_T_SCH_F,
 };
 
-extern void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bits, unsigned int len, void *priv);
+/* sbits: optional soft bits matching 'bits' (+127 = 0, -127 = 1), NULL for hard-decision input */
+extern void tp_sap_udata_ind(enum tp_sap_data_type type, int blk_num, const uint8_t *bits, const int8_t *sbits, unsigned int len, void *priv);
 
 /* 9.4.4.2.6 Synchronization continuous downlink burst */
 int build_sync_c_d_burst(uint8_t *buf, const uint8_t *sb, const uint8_t *bb, const uint8_t *bkn);
@@ -35,4 +37,19 @@ enum tetra_train_seq {
 int tetra_find_train_seq(const uint8_t *in, unsigned int end_of_in,
 			 uint32_t mask_of_train_seq, unsigned int *offset);
 
+/* same, but a sequence may differ from the reference in up to 'max_errors' bits.
+ * The first sequence to end in the buffer wins, the closest one if several end at the same bit */
+int tetra_find_train_seq_tol(const uint8_t *in, unsigned int end_of_in,
+			     uint32_t mask_of_train_seq, unsigned int max_errors,
+			     unsigned int *offset);
+
+/* check for a training sequence starting exactly at 'offset', returns its type or -1 */
+int tetra_match_train_seq(const uint8_t *in, unsigned int end_of_in,
+			  uint32_t mask_of_train_seq, unsigned int offset,
+			  unsigned int max_errors);
+
+/* set up a streaming detector for the sequences in 'mask_of_train_seq', ids are enum tetra_train_seq */
+void tetra_burst_train_det_init(struct tetra_train_det *det, uint32_t mask_of_train_seq,
+				unsigned int max_errors);
+
 #endif /* TETRA_BURST_H */
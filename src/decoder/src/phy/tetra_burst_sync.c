@@ -31,125 +31,248 @@
 #include <tetra_tdma.h>
 #include <phy/tetra_burst_sync.h>
 
-struct tetra_phy_state t_phy_state;
+void tetra_burst_rx_cb(const uint8_t *burst, const int8_t *sburst, unsigned int len, enum tetra_train_seq type, void *priv);
 
-void tetra_burst_rx_cb(const uint8_t *burst, unsigned int len, enum tetra_train_seq type, void *priv);
+/* pointer to a contiguous view of the ring starting at bit number 'bitnum' */
+static inline uint8_t *ring_bits(struct tetra_rx_state *trs, unsigned int bitnum)
+{
+	return trs->bitbuf + (bitnum & RX_RING_MASK);
+}
+
+static inline int8_t *ring_sbits(struct tetra_rx_state *trs, unsigned int bitnum)
+{
+	return trs->sbitbuf + (bitnum & RX_RING_MASK);
+}
+
+/* drop the oldest 'len' bits */
+static inline void ring_consume(struct tetra_rx_state *trs, unsigned int len)
+{
+	trs->bits_in_buf -= len;
+	trs->bitbuf_start_bitnum += len;
+}
 
-static void make_bitbuf_space(struct tetra_rx_state *trs, unsigned int len)
+/* make room for 'len' new bits, dropping the oldest ones if needed.
+ * Returns how many leading input bits have to be skipped */
+static unsigned int make_bitbuf_space(struct tetra_rx_state *trs, unsigned int len)
 {
-	unsigned int bitbuf_space = sizeof(trs->bitbuf) - trs->bits_in_buf;
+	unsigned int skip = 0;
 
-	if (bitbuf_space < len) {
-		unsigned int delta = len - bitbuf_space;
+	if (len > RX_RING_SIZE) {
+		/* only the newest RX_RING_SIZE bits can be kept */
+		skip = len - RX_RING_SIZE;
+		ring_consume(trs, trs->bits_in_buf);
+		trs->bitbuf_start_bitnum += skip;
+	} else if (RX_RING_SIZE - trs->bits_in_buf < len) {
+		unsigned int delta = len - (RX_RING_SIZE - trs->bits_in_buf);
 
-		DEBUGP("bitbuf left: %u, shrinking by %u\n", bitbuf_space, delta);
-		memmove(trs->bitbuf, trs->bitbuf + delta, trs->bits_in_buf - delta);
-		trs->bits_in_buf -= delta;
-		trs->bitbuf_start_bitnum += delta;
-		bitbuf_space = sizeof(trs->bitbuf) - trs->bits_in_buf;
+		DEBUGP("bitbuf left: %u, shrinking by %u\n", RX_RING_SIZE - trs->bits_in_buf, delta);
+		ring_consume(trs, delta);
 	}
+	return skip;
+}
+
+/* copy 'len' bytes into the ring at bit number 'bitnum', including the mirror copy */
+static void ring_write(uint8_t *ring, unsigned int bitnum, const void *data, unsigned int len)
+{
+	unsigned int pos = bitnum & RX_RING_MASK;
+	unsigned int first = RX_RING_SIZE - pos;
+
+	if (first > len)
+		first = len;
+	memcpy(ring + pos, data, first);
+	memcpy(ring + pos + RX_RING_SIZE, data, first);
+	memcpy(ring, (const uint8_t *)data + first, len - first);
+	memcpy(ring + RX_RING_SIZE, (const uint8_t *)data + first, len - first);
+}
+
+static void append_soft_bits(struct tetra_rx_state *trs, const int8_t *sbits, unsigned int len)
+{
+	unsigned int i, pos;
+	unsigned int wr = trs->bitbuf_start_bitnum + trs->bits_in_buf;
+
+	if (!trs->have_soft) {
+		/* switching from hard input, give the buffered bits full confidence */
+		for (i = 0; i < trs->bits_in_buf; i++) {
+			pos = (trs->bitbuf_start_bitnum + i) & RX_RING_MASK;
+			trs->sbitbuf[pos] = trs->sbitbuf[pos + RX_RING_SIZE] = trs->bitbuf[pos] ? -127 : 127;
+		}
+		trs->have_soft = 1;
+	}
+
+	ring_write((uint8_t *)trs->sbitbuf, wr, sbits, len);
+	/* hard decisions are still needed for the training sequence search */
+	for (i = 0; i < len; i++) {
+		pos = (wr + i) & RX_RING_MASK;
+		trs->bitbuf[pos] = trs->bitbuf[pos + RX_RING_SIZE] = sbits[i] < 0;
+	}
+}
+
+static int burst_sync_run(struct tetra_rx_state *trs);
+
+void tetra_rx_state_init(struct tetra_rx_state *trs)
+{
+	memset(trs, 0, sizeof(*trs));
+	trs->max_train_seq_errors = RX_DEF_MAX_TRAIN_SEQ_ERRORS;
+	trs->max_missed_bursts = RX_DEF_MAX_MISSED_BURSTS;
+}
+
+/* (re)build the detectors when they are new or the error tolerance changed */
+static void update_train_dets(struct tetra_rx_state *trs)
+{
+	if (trs->dets_ready && trs->sync_det.max_errors == trs->max_train_seq_errors)
+		return;
+	tetra_burst_train_det_init(&trs->sync_det, (1 << TETRA_TRAIN_SYNC), trs->max_train_seq_errors);
+	tetra_burst_train_det_init(&trs->norm_det, (1 << TETRA_TRAIN_NORM_1)|(1 << TETRA_TRAIN_NORM_2),
+				   trs->max_train_seq_errors);
+	/* the history is gone, the search restarts at the oldest buffered bit */
+	tetra_train_det_reset(&trs->sync_det, trs->bitbuf_start_bitnum);
+	trs->dets_ready = 1;
 }
 
 /* input a raw bitstream into the tetra burst synchronizaer */
 int tetra_burst_sync_in(struct tetra_rx_state *trs, uint8_t *bits, unsigned int len)
 {
+	unsigned int skip;
 	int rc;
-	unsigned int train_seq_offs;
 
 	DEBUGP("burst_sync_in: %u bits, state %u\n", len, trs->state);
 
 	/* First: append the data to the bitbuf */
-	make_bitbuf_space(trs, len);
-	memcpy(trs->bitbuf + trs->bits_in_buf, bits, len);
-	trs->bits_in_buf += len;
+	skip = make_bitbuf_space(trs, len);
+	ring_write(trs->bitbuf, trs->bitbuf_start_bitnum + trs->bits_in_buf, bits + skip, len - skip);
+	trs->have_soft = 0;
+	trs->bits_in_buf += len - skip;
+
+	rc = burst_sync_run(trs);
+	return rc < 0 ? rc : (int)len;
+}
+
+int tetra_burst_sync_in_soft(struct tetra_rx_state *trs, const int8_t *sbits, unsigned int len)
+{
+	unsigned int skip;
+	int rc;
+
+	DEBUGP("burst_sync_in_soft: %u bits, state %u\n", len, trs->state);
+
+	skip = make_bitbuf_space(trs, len);
+	append_soft_bits(trs, sbits + skip, len - skip);
+	trs->bits_in_buf += len - skip;
+
+	rc = burst_sync_run(trs);
+	return rc < 0 ? rc : (int)len;
+}
+
+/* advance the synchronizer by one step, returns 1 if it made progress,
+ * 0 if it needs more bits and a negative value if no burst was found */
+static int burst_sync_step(struct tetra_rx_state *trs)
+{
+	int rc;
+	int offset;
+	unsigned int missed;
+	const uint8_t *burst;
+	const int8_t *sburst;
+
+	update_train_dets(trs);
 
 	switch (trs->state) {
 	case RX_S_UNLOCKED:
-		if (trs->bits_in_buf < TETRA_BITS_PER_TS*2) {
-			/* wait for more bits to arrive */
-			DEBUGP("-> waiting for more bits to arrive\n");
-			return len;
+		/* the search is streaming, continue after the last bit it has seen
+		 * unless that one is not in the buffer (anymore) */
+		offset = (int)((unsigned int)trs->sync_det.bitnum - trs->bitbuf_start_bitnum);
+		if (offset < 0 || (unsigned int)offset > trs->bits_in_buf) {
+			tetra_train_det_reset(&trs->sync_det, trs->bitbuf_start_bitnum);
+			offset = 0;
 		}
 		DEBUGP("-> trying to find training sequence between bit %u and %u\n",
-			trs->bitbuf_start_bitnum, trs->bits_in_buf);
-		rc = tetra_find_train_seq(trs->bitbuf, trs->bits_in_buf,
-					  (1 << TETRA_TRAIN_SYNC), &train_seq_offs);
+			trs->bitbuf_start_bitnum + offset, trs->bits_in_buf - offset);
+		tetra_train_det_feed(&trs->sync_det, ring_bits(trs, trs->bitbuf_start_bitnum + offset),
+				     trs->bits_in_buf - offset, &rc);
 		if (rc < 0)
 			return rc;
-		// printf("found SYNC training sequence in bit #%u\n", train_seq_offs);
+		// printf("found SYNC training sequence in bit #%u\n", (unsigned int)trs->sync_det.match_bitnum);
 		trs->state = RX_S_KNOW_FSTART;
-		trs->next_frame_start_bitnum = trs->bitbuf_start_bitnum + train_seq_offs + 296;
-#if 0
-		if (train_seq_offs < 214) {
-			/* not enough leading bits for start of burst */
-			/* we just drop everything that we received so far */
-			trs->bitbuf_start_bitnum += trs->bits_in_buf;
-			trs->bits_in_buf = 0;
-		}
-#endif
-		break;
+		trs->next_frame_start_bitnum = (unsigned int)trs->sync_det.match_bitnum + 296;
+		return 1;
 	case RX_S_KNOW_FSTART:
-		/* we are locked, i.e. already know when the next frame should start */
-		if (trs->bitbuf_start_bitnum + trs->bits_in_buf < trs->next_frame_start_bitnum)
+		/* we are locked, i.e. already know when the next frame should start.
+		 * Bit numbers wrap around, so only compare their difference */
+		offset = (int)(trs->next_frame_start_bitnum - trs->bitbuf_start_bitnum);
+		if (offset < 0) {
+			/* the frame start was dropped from the buffer already */
+			trs->state = RX_S_UNLOCKED;
+			return 1;
+		}
+		if (trs->bits_in_buf < (unsigned int)offset)
 			return 0;
-		else {
-			/* shift start of frame to start of bitbuf */
-			int offset = trs->next_frame_start_bitnum - trs->bitbuf_start_bitnum;
-			int bits_remaining = trs->bits_in_buf - offset;
-
-			memmove(trs->bitbuf, trs->bitbuf+offset, bits_remaining);
-			trs->bits_in_buf = bits_remaining;
-			trs->bitbuf_start_bitnum += offset;
 
-			trs->next_frame_start_bitnum += TETRA_BITS_PER_TS;
-			trs->state = RX_S_LOCKED;
-		}
+		/* skip to the start of frame */
+		ring_consume(trs, offset);
+		trs->next_frame_start_bitnum += TETRA_BITS_PER_TS;
+		trs->state = RX_S_LOCKED;
+		trs->confidence = trs->max_missed_bursts;
+		if (trs->lock_losses)
+			trs->relocks++;
+		/* fall through */
 	case RX_S_LOCKED:
+		offset = (int)(trs->next_frame_start_bitnum - TETRA_BITS_PER_TS - trs->bitbuf_start_bitnum);
+		if (offset < 0) {
+			/* input overran the ring and dropped the burst start, the lost
+			 * bursts count as missed ones and the timing is kept */
+			missed = (-offset + TETRA_BITS_PER_TS - 1) / TETRA_BITS_PER_TS;
+			if (missed > trs->confidence) {
+				trs->state = RX_S_UNLOCKED;
+				trs->lock_losses++;
+				return 1;
+			}
+			trs->confidence -= missed;
+			trs->coasted_bursts += missed;
+			tetra_tdma_time_add_tn(&trs->phy_state->time, missed);
+			trs->next_frame_start_bitnum += missed * TETRA_BITS_PER_TS;
+			ring_consume(trs, offset + missed * TETRA_BITS_PER_TS);
+		}
 		if (trs->bits_in_buf < TETRA_BITS_PER_TS) {
 			/* not sufficient data for the full frame yet */
-			return len;
+			return 0;
+		}
+		/* we have successfully received (at least) one frame */
+		burst = ring_bits(trs, trs->bitbuf_start_bitnum);
+		sburst = trs->have_soft ? ring_sbits(trs, trs->bitbuf_start_bitnum) : NULL;
+		tetra_tdma_time_add_tn(&trs->phy_state->time, 1);
+		// printf("\nBURST");
+		DEBUGP(": %s", osmo_ubit_dump(burst, TETRA_BITS_PER_TS));
+		// printf("\n");
+		/* we know where the burst starts, so only the two possible training sequence positions are checked */
+		rc = tetra_train_det_match(&trs->sync_det, burst + 214, TETRA_BITS_PER_TS - 214);
+		if (rc < 0)
+			rc = tetra_train_det_match(&trs->norm_det, burst + 244, TETRA_BITS_PER_TS - 244);
+		if (rc >= 0) {
+			tetra_burst_rx_cb(burst, sburst, TETRA_BITS_PER_TS, rc, trs->burst_cb_priv);
+			if (trs->confidence < trs->max_missed_bursts)
+				trs->confidence++;
+		} else if (trs->confidence > 0) {
+			/* faded or corrupted burst, keep the timing and hope for the next one */
+			trs->confidence--;
+			trs->coasted_bursts++;
 		} else {
-			/* we have successfully received (at least) one frame */
-			tetra_tdma_time_add_tn(&t_phy_state.time, 1);
-			// printf("\nBURST");
-			DEBUGP(": %s", osmo_ubit_dump(trs->bitbuf, TETRA_BITS_PER_TS));
-			// printf("\n");
-			rc = tetra_find_train_seq(trs->bitbuf, trs->bits_in_buf,
-						  (1 << TETRA_TRAIN_NORM_1)|
-						  (1 << TETRA_TRAIN_NORM_2)|
-						  (1 << TETRA_TRAIN_SYNC), &train_seq_offs);
-			switch (rc) {
-			case TETRA_TRAIN_SYNC:
-				if (train_seq_offs == 214)
-					tetra_burst_rx_cb(trs->bitbuf, TETRA_BITS_PER_TS, rc, trs->burst_cb_priv);
-				else {
-					// fprintf(stderr, "#### SYNC burst at offset %u?!?\n", train_seq_offs);
-					trs->state = RX_S_UNLOCKED;
-				}
-				break;
-			case TETRA_TRAIN_NORM_1:
-			case TETRA_TRAIN_NORM_2:
-			case TETRA_TRAIN_NORM_3:
-				if (train_seq_offs == 244)
-					tetra_burst_rx_cb(trs->bitbuf, TETRA_BITS_PER_TS, rc, trs->burst_cb_priv);
-				else {
-					// fprintf(stderr, "#### SYNC burst at offset %u?!?\n", train_seq_offs);
-				}
-				break;
-			default:
-				// fprintf(stderr, "#### could not find successive burst training sequence\n");
-				trs->state = RX_S_UNLOCKED;
-				break;
-			}
-
-			/* move remainder to start of buffer */
-			trs->bits_in_buf -= TETRA_BITS_PER_TS;
-			memmove(trs->bitbuf, trs->bitbuf+TETRA_BITS_PER_TS, trs->bits_in_buf);
-			trs->bitbuf_start_bitnum += TETRA_BITS_PER_TS;
-			trs->next_frame_start_bitnum += TETRA_BITS_PER_TS;
+			// fprintf(stderr, "#### could not find successive burst training sequence\n");
+			trs->state = RX_S_UNLOCKED;
+			trs->lock_losses++;
 		}
-		break;
 
+		/* the burst stays in the ring, just move past it */
+		ring_consume(trs, TETRA_BITS_PER_TS);
+		trs->next_frame_start_bitnum += TETRA_BITS_PER_TS;
+		return 1;
 	}
-	return len;
+	return 0;
+}
+
+/* handle every burst that is complete in the buffer */
+static int burst_sync_run(struct tetra_rx_state *trs)
+{
+	int rc;
+
+	while ((rc = burst_sync_step(trs)) > 0)
+		;
+	return rc;
 }
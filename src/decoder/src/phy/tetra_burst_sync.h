@@ -2,6 +2,9 @@
 #define TETRA_BURST_SYNC_H
 
 #include <stdint.h>
+#include <phy/tetra_train_det.h>
+
+struct tetra_phy_state;
 
 enum rx_state {
 	RX_S_UNLOCKED,		/* we're completely unlocked */
@@ -9,18 +12,48 @@ enum rx_state {
 	RX_S_LOCKED,		/* fully locked */
 };
 
+/* Bits are kept in a ring indexed by bit number. Every bit is stored twice,
+ * RX_RING_SIZE apart, so any window of up to RX_RING_SIZE bits is contiguous
+ * and bursts can be handed out without copying. Must be a power of two. */
+#define RX_RING_SIZE	4096
+#define RX_RING_MASK	(RX_RING_SIZE - 1)
+
+/* defaults set by tetra_rx_state_init() */
+#define RX_DEF_MAX_TRAIN_SEQ_ERRORS	2
+#define RX_DEF_MAX_MISSED_BURSTS	8
+
 struct tetra_rx_state {
 	enum rx_state state;
 	unsigned int bits_in_buf;		/* how many bits are currently in bitbuf */
-	uint8_t bitbuf[4096];
-	unsigned int bitbuf_start_bitnum;	/* bit number at first element in bitbuf */
+	uint8_t bitbuf[RX_RING_SIZE * 2];
+	int8_t sbitbuf[RX_RING_SIZE * 2];	/* soft bits matching bitbuf, valid if have_soft */
+	int have_soft;				/* last input was soft bits */
+	unsigned int bitbuf_start_bitnum;	/* bit number of the oldest bit in bitbuf */
 	unsigned int next_frame_start_bitnum;	/* frame start expected at this bitnum */
+	unsigned int max_train_seq_errors;	/* bit errors accepted in a training sequence */
+	struct tetra_train_det sync_det;	/* streaming SYNC search while unlocked */
+	struct tetra_train_det norm_det;	/* normal burst check while locked */
+	int dets_ready;				/* detectors are set up for max_train_seq_errors */
 
+	/* flywheel: bursts without a training sequence keep the TDMA timing
+	 * until the confidence score decays to zero */
+	unsigned int max_missed_bursts;		/* confidence after lock, 0 = unlock on first miss */
+	unsigned int confidence;		/* +1 per good burst, -1 per missed one */
+	unsigned int lock_losses;		/* times the lock decayed */
+	unsigned int relocks;			/* times the lock was regained after a loss */
+	unsigned int coasted_bursts;		/* bursts passed without a training sequence */
+
+	struct tetra_phy_state *phy_state;	/* owned by the MAC state, advanced on every burst */
 	void *burst_cb_priv;
 };
 
+/* clear the state and set the default tolerances */
+void tetra_rx_state_init(struct tetra_rx_state *trs);
 
 /* input a raw bitstream into the tetra burst synchronizaer */
 int tetra_burst_sync_in(struct tetra_rx_state *trs, uint8_t *bits, unsigned int len);
 
+/* input a soft bitstream (+127 = 0, -127 = 1) into the tetra burst synchronizer */
+int tetra_burst_sync_in_soft(struct tetra_rx_state *trs, const int8_t *sbits, unsigned int len);
+
 #endif /* TETRA_BURST_SYNC_H */
@@ -0,0 +1,118 @@
+/* Streaming training sequence detector, see tetra_train_det.h */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <phy/tetra_train_det.h>
+
+void tetra_train_det_init(struct tetra_train_det *det, unsigned int max_errors)
+{
+	memset(det, 0, sizeof(*det));
+	det->max_errors = max_errors;
+	det->match_id = -1;
+}
+
+int tetra_train_det_add(struct tetra_train_det *det, int id, const uint8_t *bits, unsigned int len)
+{
+	struct tetra_train_det_seq *seq;
+	unsigned int i;
+
+	if (det->num_seqs >= TRAIN_DET_MAX_SEQS || len == 0 || len > 64)
+		return -1;
+
+	seq = &det->seqs[det->num_seqs];
+	seq->id = id;
+	seq->len = len;
+	seq->bits = 0;
+	for (i = 0; i < len; i++)
+		seq->bits = (seq->bits << 1) | (bits[i] & 1);
+	seq->mask = (len == 64) ? ~(uint64_t)0 : (((uint64_t)1 << len) - 1);
+
+	return det->num_seqs++;
+}
+
+void tetra_train_det_reset(struct tetra_train_det *det, uint64_t bitnum)
+{
+	det->reg = 0;
+	det->valid = 0;
+	det->bitnum = bitnum;
+}
+
+/* closest sequence that ends in the LSB of 'reg', 'valid' bits of it are usable */
+static inline int best_seq(const struct tetra_train_det *det, uint64_t reg, unsigned int valid, unsigned int *errors)
+{
+	unsigned int i, errs, best_errs = det->max_errors + 1;
+	int best = -1;
+
+	for (i = 0; i < det->num_seqs; i++) {
+		const struct tetra_train_det_seq *seq = &det->seqs[i];
+
+		if (valid < seq->len)
+			continue;
+		errs = __builtin_popcountll((reg ^ seq->bits) & seq->mask);
+		if (errs < best_errs) {
+			best_errs = errs;
+			best = i;
+		}
+	}
+	*errors = best_errs;
+	return best;
+}
+
+unsigned int tetra_train_det_feed(struct tetra_train_det *det, const uint8_t *bits, unsigned int len, int *id)
+{
+	uint64_t reg = det->reg;
+	unsigned int valid = det->valid;
+	unsigned int i, errors;
+	int best = -1;
+
+	for (i = 0; i < len; i++) {
+		reg = (reg << 1) | (bits[i] & 1);
+		if (valid < 64)
+			valid++;
+
+		best = best_seq(det, reg, valid, &errors);
+		if (best >= 0) {
+			i++;
+			break;
+		}
+	}
+
+	det->reg = reg;
+	det->valid = valid;
+	det->bitnum += i;
+	if (best < 0) {
+		*id = -1;
+		return len;
+	}
+
+	det->match_id = det->seqs[best].id;
+	det->match_errors = errors;
+	det->match_bitnum = det->bitnum - det->seqs[best].len;
+	*id = det->match_id;
+	return i;
+}
+
+int tetra_train_det_match(const struct tetra_train_det *det, const uint8_t *in, unsigned int avail)
+{
+	uint64_t window = 0;
+	unsigned int i, errs, best_errs = det->max_errors + 1;
+	int best = -1;
+
+	/* first bit in the MSB, so every sequence is just a shift away */
+	for (i = 0; i < 64; i++)
+		window = (window << 1) | (i < avail ? in[i] & 1 : 0);
+
+	for (i = 0; i < det->num_seqs; i++) {
+		const struct tetra_train_det_seq *seq = &det->seqs[i];
+
+		if (avail < seq->len)
+			continue;
+		errs = __builtin_popcountll((window >> (64 - seq->len)) ^ seq->bits);
+		if (errs < best_errs) {
+			best_errs = errs;
+			best = seq->id;
+		}
+	}
+	return best;
+}
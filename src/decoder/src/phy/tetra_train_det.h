@@ -0,0 +1,55 @@
+#ifndef TETRA_TRAIN_DET_H
+#define TETRA_TRAIN_DET_H
+
+/* Streaming training sequence detector.
+ *
+ * Bits are shifted into a 64-bit register, newest bit in the LSB. After
+ * every bit each registered sequence is compared against the newest bits
+ * with one XOR, mask and popcount, so the cost per bit does not depend on
+ * the sequence lengths. */
+
+#include <stdint.h>
+
+#define TRAIN_DET_MAX_SEQS	8
+
+struct tetra_train_det_seq {
+	int id;			/* reported on a match, e.g. enum tetra_train_seq */
+	unsigned int len;	/* 1..64 bits */
+	uint64_t bits;		/* first bit in bit len-1 */
+	uint64_t mask;		/* low len bits set */
+};
+
+struct tetra_train_det {
+	struct tetra_train_det_seq seqs[TRAIN_DET_MAX_SEQS];
+	unsigned int num_seqs;
+	unsigned int max_errors;	/* bit errors accepted in a sequence */
+
+	uint64_t reg;			/* newest bits, newest in the LSB */
+	unsigned int valid;		/* how many bits of reg are valid, up to 64 */
+	uint64_t bitnum;		/* bits fed since the last reset */
+
+	/* last match */
+	int match_id;
+	unsigned int match_errors;
+	uint64_t match_bitnum;		/* bit number of the first bit of the matched sequence */
+};
+
+/* forget all sequences and the history */
+void tetra_train_det_init(struct tetra_train_det *det, unsigned int max_errors);
+
+/* register a sequence of 'len' unpacked bits, returns its index or -1 if full */
+int tetra_train_det_add(struct tetra_train_det *det, int id, const uint8_t *bits, unsigned int len);
+
+/* forget the history only, the next bit gets bit number 'bitnum' */
+void tetra_train_det_reset(struct tetra_train_det *det, uint64_t bitnum);
+
+/* Feed up to 'len' bits, stopping right after the first bit that completes
+ * a sequence. Returns the number of bits consumed, *id is the matching
+ * sequence id or -1. The match details are kept in det->match_* */
+unsigned int tetra_train_det_feed(struct tetra_train_det *det, const uint8_t *bits, unsigned int len, int *id);
+
+/* Compare the sequences against the bits starting at in[0] without touching
+ * the history. Returns the id of the closest match or -1 */
+int tetra_train_det_match(const struct tetra_train_det *det, const uint8_t *in, unsigned int avail);
+
+#endif /* TETRA_TRAIN_DET_H */
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <assert.h>
 
 #include "tetra_common.h"
 
@@ -49,7 +50,7 @@ const char *get_value_string(const struct value_string *vs, uint32_t val)
 	if (str)
 		return str;
 
-	static char namebuf[255];
+	static __thread char namebuf[255];
 	snprintf(namebuf, sizeof(namebuf), "unknown 0x%"PRIx32, val);
 	namebuf[sizeof(namebuf) - 1] = '\0';
 	return namebuf;
@@ -83,6 +84,7 @@ struct msgb *msgb_alloc_c(uint16_t size, const char *name)
 	msg->data = msg->_data;
 	msg->head = msg->_data;
 	msg->tail = msg->_data;
+	msg->dirty = msg->_data;
 
 	return msg;
 }
@@ -101,6 +103,55 @@ struct msgb *msgb_alloc(uint16_t size, const char *name)
 	return msgb_alloc_c(size, name);
 }
 
+struct msgb *msgb_pool_alloc(struct msgb_pool *pool, uint16_t size, const char *name)
+{
+	struct msgb *msg;
+	unsigned int i, best = pool->num_free;
+
+	/* smallest released msgb that fits, so small requests don't eat the big ones */
+	for (i = 0; i < pool->num_free; i++) {
+		if (pool->msgs[i]->data_len >= size &&
+		    (best == pool->num_free || pool->msgs[i]->data_len < pool->msgs[best]->data_len))
+			best = i;
+	}
+	if (best == pool->num_free) {
+		pool->heap_allocs++;
+		return msgb_alloc_c(size, name);
+	}
+
+	msg = pool->msgs[best];
+	pool->msgs[best] = pool->msgs[--pool->num_free];
+	assert(msg->data_len >= size);
+
+	/* same state as a freshly allocated msgb: the rest of the buffer was never written */
+	memset(msg->_data, 0x00, msg->dirty - msg->_data);
+	size = msg->data_len;
+	memset(msg, 0x00, sizeof(*msg));
+	msg->data_len = size;
+	msg->data = msg->_data;
+	msg->head = msg->_data;
+	msg->tail = msg->_data;
+	msg->dirty = msg->_data;
+
+	return msg;
+}
+
+void msgb_pool_release(struct msgb_pool *pool, struct msgb *msg)
+{
+	if (!msg)
+		return;
+	if (pool->num_free < MSGB_POOL_SIZE)
+		pool->msgs[pool->num_free++] = msg;
+	else
+		free(msg);
+}
+
+void msgb_pool_drain(struct msgb_pool *pool)
+{
+	while (pool->num_free)
+		free(pool->msgs[--pool->num_free]);
+}
+
 
 
 
@@ -208,8 +259,46 @@ const char *tetra_get_sap_name(uint8_t sap)
 	return get_value_string(tetra_sap_names, sap);
 }
 
-void tetra_mac_state_init(struct tetra_mac_state *tms)
+int tetra_mac_state_init(struct tetra_mac_state *tms)
 {
 	// INIT_LLIST_HEAD(&tms->voice_channels);
 	tms->codec_first_pass = true;
+	return tetra_lower_mac_init(tms);
+}
+
+void tetra_mac_state_free(struct tetra_mac_state *tms)
+{
+	int i;
+
+	if (tms->fragslots) {
+		for (i = 0; i < FRAGSLOT_NR_SLOTS; i++) {
+			msgb_pool_release(&tms->msgb_pool, tms->fragslots[i].msgb);
+			tms->fragslots[i].msgb = NULL;
+			tms->fragslots[i].active = 0;
+		}
+	}
+	msgb_pool_drain(&tms->msgb_pool);
+	while (tms->num_free_prims)
+		free(tms->free_prims[--tms->num_free_prims]);
+	osmo_conv_cache_free(&tms->conv_cache);
+	for (i = 0; i < TETRA_BLK_TYPES; i++) {
+		free(tms->gather_map[i]);
+		tms->gather_map[i] = NULL;
+	}
+}
+
+unsigned long tetra_mac_heap_allocs(struct tetra_mac_state *tms)
+{
+	return tms->msgb_pool.heap_allocs + tms->prim_heap_allocs;
+}
+
+double tetra_decode_saved_ns(const struct tetra_mac_state *tms)
+{
+	const struct tetra_decode_stats *st = &tms->decode_stats;
+	double ns = st->codec_skipped * st->codec_ns;
+	int i;
+
+	for (i = 0; i < TETRA_BLK_TYPES; i++)
+		ns += st->fec_skipped[i] * st->fec_ns[i];
+	return ns;
 }
@@ -12,6 +12,8 @@
 // #include <osmocom/core/linuxlist.h>
 
 #include "tetra_fragslot.h"
+#include "lower_mac/osmo_conv.h"
+#include "lower_mac/tetra_scramb.h"
 
 
 struct value_string {
@@ -55,6 +57,7 @@ struct msgb {
 	unsigned char *head;	/*!< start of underlying memory buffer */
 	unsigned char *tail;	/*!< end of message in buffer */
 	unsigned char *data;	/*!< start of message in buffer */
+	unsigned char *dirty;	/*!< end of the data msgb_put handed out, a pooled msgb is cleared up to here */
 	unsigned char _data[0]; /*!< optional immediate data array */
 };
 
@@ -81,6 +84,23 @@ struct msgb *msgb_alloc_c(uint16_t size, const char *name);
  */
 struct msgb *msgb_alloc(uint16_t size, const char *name);
 
+/* Free list of msgbs owned by one decoder instance. Released buffers are kept for
+ * reuse instead of going back to the heap, so the steady state doesn't allocate */
+#define MSGB_POOL_SIZE 16
+struct msgb_pool {
+	struct msgb *msgs[MSGB_POOL_SIZE];
+	unsigned int num_free;
+	unsigned long heap_allocs;	/* msgbs that had to be malloc'ed */
+};
+
+/* same as msgb_alloc, but reuses a released msgb of at least 'size' octets if there is one.
+ * Only the header and the data written since the last use are cleared */
+struct msgb *msgb_pool_alloc(struct msgb_pool *pool, uint16_t size, const char *name);
+/* give the msgb back to the pool, it is freed if the pool is full */
+void msgb_pool_release(struct msgb_pool *pool, struct msgb *msg);
+/* free all msgbs held by the pool */
+void msgb_pool_drain(struct msgb_pool *pool);
+
 /*! obtain L1 header of msgb */
 #define msgb_l1(m)	((void *)((m)->l1h))
 /*! obtain L2 header of msgb */
@@ -162,6 +182,13 @@ static inline int msgb_tailroom(const struct msgb *msgb)
 	return (unsigned int) ((msgb->head + msgb->data_len) - msgb->tail);
 }
 
+/*! record a direct write to the buffer up to 'end', so a pooled msgb clears it on reuse */
+static inline void msgb_touch(struct msgb *msgb, unsigned char *end)
+{
+	if (end > msgb->dirty)
+		msgb->dirty = end;
+}
+
 /*! append data to end of message buffer
  *  \param[in] msgb message buffer
  *  \param[in] len number of bytes to append to message
@@ -183,6 +210,7 @@ static inline unsigned char *msgb_put(struct msgb *msgb, unsigned int len)
 	}
 	msgb->tail += len;
 	msgb->len += len;
+	msgb_touch(msgb, msgb->tail);
 	return tmp;
 }
 
@@ -263,7 +291,17 @@ uint32_t bits_to_uint(const uint8_t *bits, unsigned int len);
 struct tetra_phy_state {
 	struct tetra_tdma_time time;
 };
-extern struct tetra_phy_state t_phy_state;
+
+/* cell parameters learned from the SYNC PDU */
+struct tetra_cell_data {
+	uint16_t mcc;
+	uint16_t mnc;
+	uint8_t colour_code;
+	struct tetra_tdma_time time;
+
+	uint32_t scramb_init;
+	struct tetra_scramb_seq scramb_seq;	/* sequence of scramb_init */
+};
 
 struct tetra_display_state {
 	int curr_hyperframe;//
@@ -295,6 +333,41 @@ struct tetra_display_state {
 	bool reg_mandatory;
 };
 
+#define TMVSAP_PRIM_POOL_SIZE 4
+#define TETRA_BLK_TYPES 6	/* entries of enum tp_sap_data_type */
+struct tetra_tmvsap_prim;
+
+/* What the lower MAC does with a block, see get_decode_action() in tetra_lower_mac.c */
+enum tetra_decode_action {
+	TETRA_DECODE_FULL,	/* FEC, CRC and upper MAC */
+	TETRA_DECODE_CRC,	/* FEC and CRC for the statistics, the PDUs are dropped */
+	TETRA_DECODE_SKIP,	/* nothing */
+};
+
+#define TETRA_DECODE_MAX_TALKGROUPS 16
+
+/* Blocks nobody consumes are not decoded. The AACH tells what a slot carries, sync and AACH
+ * blocks are always decoded. A zeroed policy decodes everything */
+struct tetra_decode_policy {
+	uint8_t timeslots;			/* bit n = timeslot n+1 wanted, 0 = all */
+	enum tetra_decode_action other_slots;	/* signalling of the timeslots not wanted */
+	uint64_t usage_markers;			/* bit n = traffic with DL usage marker n wanted, 0 = all */
+	uint32_t talkgroups[TETRA_DECODE_MAX_TALKGROUPS];	/* traffic of these SSIs only */
+	unsigned int num_talkgroups;		/* 0 = all, else timeslot 1 (MCCH) is always parsed */
+};
+
+/* Work the policy saved. The costs are running averages of the decodes that did run, the
+ * codec cost stays 0 while put_traffic_block hands the speech to the owner */
+struct tetra_decode_stats {
+	unsigned long fec_run[TETRA_BLK_TYPES];
+	unsigned long fec_skipped[TETRA_BLK_TYPES];	/* incl. the SCH/F of every speech slot */
+	unsigned long crc_only;				/* decoded but not parsed */
+	unsigned long codec_run;
+	unsigned long codec_skipped;			/* speech of unwanted or inactive slots */
+	double fec_ns[TETRA_BLK_TYPES];			/* FEC and CRC of one block, sampled average */
+	double codec_ns;				/* one speech frame, sampled average */
+};
+
 struct tetra_mac_state {
 	// struct llist_head voice_channels;
 	struct {
@@ -305,6 +378,8 @@ struct tetra_mac_state {
 	struct tetra_si_decoded last_sid;
 
 	struct tetra_crypto_state *tcs; /* contains all state relevant to encryption */
+	struct tetra_phy_state phy_state; /* TDMA time as tracked by the PHY */
+	struct tetra_cell_data cell_data; /* current cell, updated by the lower MAC */
 
 	char *dumpdir;	/* Where to save traffic channel dump */
 	int ssi;	/* SSI */
@@ -316,16 +391,47 @@ struct tetra_mac_state {
 	bool codec_first_pass;
 	
 	void (*put_voice_data)(void* ctx, int count, int16_t* data);
-	void* put_voice_data_ctx;
+	/* if set, the 432 coded speech values of the active timeslot go here instead of the codec */
+	void (*put_traffic_block)(void* ctx, const int16_t* block);
+	void* put_voice_data_ctx;	/* for both callbacks */
 	int last_frame;
 	int curr_active_timeslot;
 	
 	struct fragslot* fragslots;
-};
 
-extern struct tetra_display_state t_display_state;
+	/* Recycled msgbs and TMV-SAP primitives, they are taken and released once per burst */
+	struct msgb_pool msgb_pool;
+	struct tetra_tmvsap_prim *free_prims[TMVSAP_PRIM_POOL_SIZE];
+	unsigned int num_free_prims;
+	unsigned long prim_heap_allocs;
+
+	/* CRC results by enum tp_sap_data_type, the RM(30,14) check for the AACH. SCH/F blocks
+	 * carrying speech are not counted */
+	unsigned long crc_ok[TETRA_BLK_TYPES];
+	unsigned long crc_fail[TETRA_BLK_TYPES];
+
+	struct osmo_conv_cache conv_cache;	/* Viterbi decoders for the block types seen so far */
+	/* fused deinterleave and depuncture tables by enum tp_sap_data_type, see tetra_lower_mac_init() */
+	uint16_t *gather_map[TETRA_BLK_TYPES];
+
+	struct tetra_decode_policy decode_policy;
+	struct tetra_decode_stats decode_stats;
+	uint32_t usage_marker_ssi[64];	/* SSI last given each DL usage marker by a MAC-RESOURCE */
+};
 
-void tetra_mac_state_init(struct tetra_mac_state *tms);
+/* 0 or -ENOMEM, tetra_mac_state_free() releases what was set up either way */
+int tetra_mac_state_init(struct tetra_mac_state *tms);
+/* build the deinterleave/depuncture tables of the lower MAC, part of tetra_mac_state_init() */
+int tetra_lower_mac_init(struct tetra_mac_state *tms);
+/* release the pooled buffers and fragslot msgbs, tms itself is owned by the caller */
+void tetra_mac_state_free(struct tetra_mac_state *tms);
+/* number of msgbs and primitives taken from the heap instead of the pools */
+unsigned long tetra_mac_heap_allocs(struct tetra_mac_state *tms);
+/* estimated CPU time the decode policy saved so far, in ns */
+double tetra_decode_saved_ns(const struct tetra_mac_state *tms);
+/* run the ETSI speech codec on one coded TCH/S block, 480 samples out. Serialized with a
+ * process-wide lock, the codec state is shared by all decoders */
+void tetra_speech_decode(int16_t *interleaved_coded_array, bool first_pass, int16_t *synth);
 
 #define TETRA_CRC_OK	0x1d0f
 
@@ -0,0 +1,367 @@
+/* Synthetic TETRA downlink generator, see tetra_gen.h */
+
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tetra_gen.h>
+#include <tetra_common.h>
+#include <tetra_mac_pdu.h>
+#include <phy/tetra_burst.h>
+#include <lower_mac/crc_simple.h>
+#include <lower_mac/tetra_conv_enc.h>
+#include <lower_mac/tetra_interleave.h>
+#include <lower_mac/tetra_rm3014.h>
+#include <lower_mac/tetra_scramb.h>
+
+/* channel coding of the 2/3 rate blocks, the inverse of tp_sap_udata_ind() */
+struct gen_blk_param {
+	uint16_t type345_bits;
+	uint16_t type1_bits;
+	uint16_t interleave_a;
+};
+
+static const struct gen_blk_param blk_sb1 = { 120,  60,  11 };
+static const struct gen_blk_param blk_ndb = { 216, 124, 101 };
+
+/* MAC PDU types, 21.4.1 */
+#define MAC_PDU_RESOURCE	0
+#define MAC_PDU_BROADCAST	2
+#define BCAST_SYSINFO		0
+
+static void put_bits(uint8_t *out, uint32_t val, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		out[i] = (val >> (len - 1 - i)) & 1;
+}
+
+/* type-1 bits to scrambled type-5 bits: CRC, tail, 1/4 mother code,
+ * 2/3 puncturing, block interleaving and scrambling */
+static void encode_block(const struct gen_blk_param *bp, const uint8_t *type1,
+			 uint32_t scramb_init, uint8_t *type5)
+{
+	uint8_t type2[288 + 4];
+	uint8_t mother[(288 + 4) * 4];
+	uint8_t type3[432];
+	struct conv_enc_state ces;
+	unsigned int type2_bits = bp->type1_bits + 16 + 4;
+	uint16_t crc;
+
+	memcpy(type2, type1, bp->type1_bits);
+	crc = ~crc16_ccitt_bits(type2, bp->type1_bits);
+	put_bits(type2 + bp->type1_bits, crc, 16);
+	memset(type2 + bp->type1_bits + 16, 0, 4);
+
+	conv_enc_init(&ces);
+	conv_enc_input(&ces, type2, type2_bits, mother);
+	get_punctured_rate(TETRA_RCPC_PUNCT_2_3, mother, bp->type345_bits, type3);
+	block_interleave(bp->type345_bits, bp->interleave_a, type3, type5);
+	tetra_scramb_bits(scramb_init, type5, bp->type345_bits);
+}
+
+/* AACH, 21.4.7: RM(30,14) coded and scrambled with the cell code */
+static void encode_aach(struct tetra_gen *gen, uint8_t hdr, uint8_t field1, uint8_t field2, uint8_t *bb)
+{
+	uint16_t aach = (hdr << 12) | ((field1 & 0x3f) << 6) | (field2 & 0x3f);
+
+	put_bits(bb, tetra_rm3014_compute(aach), 30);
+	tetra_scramb_bits(gen->scramb_init, bb, 30);
+}
+
+/* SYNC PDU, 21.4.4.2, with D-MLE-SYNC, 18.4.2 */
+static void build_sync_pdu(struct tetra_gen *gen, const struct tetra_tdma_time *t, uint8_t *out)
+{
+	const struct tetra_gen_cfg *cfg = &gen->cfg;
+	uint8_t *cur = out;
+
+	put_bits(cur, cfg->system_code, 4); cur += 4;
+	put_bits(cur, cfg->colour_code, 6); cur += 6;
+	put_bits(cur, t->tn - 1, 2); cur += 2;
+	put_bits(cur, t->fn, 5); cur += 5;
+	put_bits(cur, t->mn, 6); cur += 6;
+	put_bits(cur, 0, 2); cur += 2;	/* continuous transmission */
+	put_bits(cur, 0, 3); cur += 3;	/* TS reserved frames */
+	put_bits(cur, 0, 1); cur += 1;	/* U-plane DTX */
+	put_bits(cur, 0, 1); cur += 1;	/* frame 18 extension */
+	put_bits(cur, 0, 1); cur += 1;	/* reserved */
+	put_bits(cur, cfg->mcc, 10); cur += 10;
+	put_bits(cur, cfg->mnc, 14); cur += 14;
+	put_bits(cur, 0, 2); cur += 2;	/* neighbour cell broadcast */
+	put_bits(cur, 2, 2); cur += 2;	/* cell service level */
+	put_bits(cur, 0, 1);		/* late entry */
+}
+
+/* SYSINFO, 21.4.4.1, with D-MLE-SYSINFO, 18.4.2 */
+static void build_sysinfo_pdu(struct tetra_gen *gen, const struct tetra_tdma_time *t, uint8_t *out)
+{
+	const struct tetra_gen_cfg *cfg = &gen->cfg;
+	uint8_t band = cfg->dl_freq / 100000000;
+	uint16_t carrier = 0;
+	uint8_t offset = 0, off;
+	int64_t err, best = INT64_MAX;
+	uint8_t *cur = out;
+
+	/* closest carrier number and offset the decoder maps back to dl_freq */
+	for (off = 0; off < 4; off++) {
+		int64_t c = ((int64_t)cfg->dl_freq - tetra_dl_carrier_hz(band, 0, off) + 12500) / 25000;
+
+		if (c < 0 || c > 4095)
+			continue;
+		err = llabs((int64_t)cfg->dl_freq - tetra_dl_carrier_hz(band, c, off));
+		if (err < best) {
+			best = err;
+			carrier = c;
+			offset = off;
+		}
+	}
+
+	put_bits(cur, MAC_PDU_BROADCAST, 2); cur += 2;
+	put_bits(cur, BCAST_SYSINFO, 2); cur += 2;
+	put_bits(cur, carrier, 12); cur += 12;
+	put_bits(cur, band, 4); cur += 4;
+	put_bits(cur, offset, 2); cur += 2;
+	put_bits(cur, 0, 3); cur += 3;	/* duplex spacing */
+	put_bits(cur, 0, 1); cur += 1;	/* reverse operation */
+	put_bits(cur, 0, 2); cur += 2;	/* no secondary control channels */
+	put_bits(cur, 1, 3); cur += 3;	/* MS txpwr max 15 dBm */
+	put_bits(cur, 0, 4); cur += 4;	/* rxlev access min -125 dBm */
+	put_bits(cur, 7, 4); cur += 4;	/* access parameter -39 dBm */
+	put_bits(cur, 15, 4); cur += 4;	/* radio downlink timeout */
+	put_bits(cur, 0, 1); cur += 1;	/* hyperframe number follows */
+	put_bits(cur, t->hn, 16); cur += 16;
+	put_bits(cur, TETRA_MAC_OPT_FIELD_ACCESS_CODE, 2); cur += 2;
+	put_bits(cur, 0, 20); cur += 20;
+	put_bits(cur, cfg->la, 14); cur += 14;
+	put_bits(cur, 0xffff, 16); cur += 16;	/* all subscriber classes */
+	put_bits(cur, cfg->service_details, 12);
+}
+
+/* MAC-RESOURCE with the null address and fill bits, 21.4.3.1 */
+static void build_null_pdu(uint8_t *out)
+{
+	uint8_t *cur = out;
+
+	memset(out, 0, blk_ndb.type1_bits);
+	put_bits(cur, MAC_PDU_RESOURCE, 2); cur += 2;
+	put_bits(cur, 1, 1); cur += 1;	/* fill bits present */
+	put_bits(cur, 0, 1); cur += 1;	/* grant position */
+	put_bits(cur, 0, 2); cur += 2;	/* not encrypted */
+	put_bits(cur, 0, 1); cur += 1;	/* random access flag */
+	put_bits(cur, 2, 6); cur += 6;	/* 2 octets */
+	put_bits(cur, ADDR_TYPE_NULL, 3); cur += 3;
+	*cur = 1;			/* first fill bit */
+}
+
+/* frame 18 slots of BSCH and BNCH, 9.5.2 */
+static int is_bsch(const struct tetra_tdma_time *t)
+{
+	return t->fn == 18 && t->tn == 4 - ((t->mn + 1) % 4);
+}
+
+static int is_bnch(const struct tetra_tdma_time *t)
+{
+	return t->fn == 18 && t->tn == 4 - ((t->mn + 3) % 4);
+}
+
+static uint8_t prbs_bit(struct tetra_gen *gen)
+{
+	/* xorshift32 */
+	gen->prbs ^= gen->prbs << 13;
+	gen->prbs ^= gen->prbs >> 17;
+	gen->prbs ^= gen->prbs << 5;
+	return gen->prbs & 1;
+}
+
+static void next_voice_block(struct tetra_gen *gen, uint8_t *out)
+{
+	const struct tetra_gen_cfg *cfg = &gen->cfg;
+	int i;
+
+	if (!cfg->voice || !cfg->voice_frames) {
+		for (i = 0; i < TETRA_GEN_VOICE_BITS; i++)
+			out[i] = prbs_bit(gen);
+		return;
+	}
+	memcpy(out, cfg->voice + (size_t)gen->voice_pos * TETRA_GEN_VOICE_BITS, TETRA_GEN_VOICE_BITS);
+	gen->voice_pos = (gen->voice_pos + 1) % cfg->voice_frames;
+}
+
+static void advance_time(struct tetra_tdma_time *t)
+{
+	if (++t->tn <= 4)
+		return;
+	t->tn = 1;
+	if (++t->fn <= 18)
+		return;
+	t->fn = 1;
+	if (++t->mn <= 60)
+		return;
+	t->mn = 1;
+	t->hn++;
+}
+
+static float rrc_tap(float t, float alpha)
+{
+	float x;
+
+	if (fabsf(t) < 1e-6f)
+		return 1.0f - alpha + 4.0f * alpha / (float)M_PI;
+	if (fabsf(fabsf(t) - 1.0f / (4.0f * alpha)) < 1e-6f)
+		return alpha / sqrtf(2.0f) * ((1.0f + 2.0f / (float)M_PI) * sinf((float)M_PI / (4.0f * alpha)) +
+					      (1.0f - 2.0f / (float)M_PI) * cosf((float)M_PI / (4.0f * alpha)));
+	x = 4.0f * alpha * t;
+	return (sinf((float)M_PI * t * (1.0f - alpha)) + x * cosf((float)M_PI * t * (1.0f + alpha))) /
+	       ((float)M_PI * t * (1.0f - x * x));
+}
+
+void tetra_gen_cfg_default(struct tetra_gen_cfg *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->mcc = 901;
+	cfg->mnc = 9999;
+	cfg->colour_code = 1;
+	cfg->la = 1;
+	cfg->dl_freq = 420000000;
+	cfg->service_details = TETRA_GEN_SRV_REG | TETRA_GEN_SRV_DEREG | TETRA_GEN_SRV_VOICE |
+			       TETRA_GEN_SRV_NORMAL_MODE | TETRA_GEN_SRV_NEVER_MIN_MODE;
+	cfg->hyperframe = 1;
+	cfg->traffic_mask = 1 << 1;
+	cfg->usage_marker[0] = cfg->usage_marker[1] = cfg->usage_marker[2] = cfg->usage_marker[3] = 4;
+	cfg->seed = 1;
+}
+
+int tetra_gen_init(struct tetra_gen *gen, const struct tetra_gen_cfg *cfg)
+{
+	float energy = 0;
+	int i;
+
+	if (cfg->mcc > 1023 || cfg->mnc > 16383 || cfg->colour_code > 63 ||
+	    cfg->system_code > 15 || cfg->la > 16383 || cfg->service_details > 0xfff ||
+	    cfg->dl_freq >= 1600000000 || cfg->traffic_mask > 0xf)
+		return -EINVAL;
+	for (i = 0; i < 4; i++) {
+		if ((cfg->traffic_mask & (1 << i)) && (cfg->usage_marker[i] < 4 || cfg->usage_marker[i] > 63))
+			return -EINVAL;
+	}
+
+	memset(gen, 0, sizeof(*gen));
+	gen->cfg = *cfg;
+	gen->time.hn = cfg->hyperframe;
+	gen->time.mn = 1;
+	gen->time.fn = 1;
+	gen->time.tn = 1;
+	gen->scramb_init = tetra_scramb_get_init(cfg->mcc, cfg->mnc, cfg->colour_code);
+	gen->prbs = cfg->seed ? cfg->seed : 1;
+
+	/* unit average output power */
+	for (i = 0; i < TETRA_GEN_RRC_TAPS; i++) {
+		gen->rrc[i] = rrc_tap((float)(i - TETRA_GEN_RRC_TAPS / 2) / TETRA_GEN_SPS, TETRA_GEN_RRC_ALPHA);
+		energy += gen->rrc[i] * gen->rrc[i];
+	}
+	for (i = 0; i < TETRA_GEN_RRC_TAPS; i++)
+		gen->rrc[i] *= sqrtf(TETRA_GEN_SPS / energy);
+
+	return 0;
+}
+
+int tetra_gen_burst(struct tetra_gen *gen, uint8_t *bits, struct tetra_tdma_time *time)
+{
+	const struct tetra_tdma_time *t = &gen->time;
+	uint8_t type1[124];
+	uint8_t sb[120], bb[30], bkn1[432], bkn2[216];
+	int slot = t->tn - 1;
+	int type;
+
+	if (time)
+		*time = *t;
+
+	if (t->fn == 18) {
+		/* frame 18 is control only, the AACH carries access fields */
+		encode_aach(gen, TETRA_ACC_ASS_ULCO, 0, 0, bb);
+		if (is_bsch(t)) {
+			build_sync_pdu(gen, t, type1);
+			encode_block(&blk_sb1, type1, SCRAMB_INIT, sb);
+			build_sysinfo_pdu(gen, t, type1);
+			encode_block(&blk_ndb, type1, gen->scramb_init, bkn2);
+			build_sync_c_d_burst(bits, sb, bb, bkn2);
+			type = TETRA_TRAIN_SYNC;
+		} else {
+			if (is_bnch(t))
+				build_sysinfo_pdu(gen, t, type1);
+			else
+				build_null_pdu(type1);
+			encode_block(&blk_ndb, type1, gen->scramb_init, bkn1);
+			build_null_pdu(type1);
+			encode_block(&blk_ndb, type1, gen->scramb_init, bkn2);
+			build_norm_c_d_burst(bits, bkn1, bb, bkn2, 1);
+			type = TETRA_TRAIN_NORM_2;
+		}
+	} else if (gen->cfg.traffic_mask & (1 << slot)) {
+		/* TCH/S: the coded speech block is only scrambled */
+		encode_aach(gen, TETRA_ACC_ASS_DLF1_ULF1, gen->cfg.usage_marker[slot], gen->cfg.usage_marker[slot], bb);
+		next_voice_block(gen, bkn1);
+		tetra_scramb_bits(gen->scramb_init, bkn1, TETRA_GEN_VOICE_BITS);
+		build_norm_c_d_burst(bits, bkn1, bb, bkn1 + 216, 0);
+		type = TETRA_TRAIN_NORM_1;
+	} else {
+		encode_aach(gen, TETRA_ACC_ASS_DLCC_ULCO, 0, 0, bb);
+		build_null_pdu(type1);
+		encode_block(&blk_ndb, type1, gen->scramb_init, bkn1);
+		encode_block(&blk_ndb, type1, gen->scramb_init, bkn2);
+		build_norm_c_d_burst(bits, bkn1, bb, bkn2, 1);
+		type = TETRA_TRAIN_NORM_2;
+	}
+
+	advance_time(&gen->time);
+	return type;
+}
+
+void tetra_gen_modulate(struct tetra_gen *gen, const uint8_t *bits, unsigned int len, float *iq)
+{
+	/* phase change per dibit, first bit is the MSB: 00, 01, 10, 11 */
+	static const float dphi[4] = { M_PI / 4, 3 * M_PI / 4, -M_PI / 4, -3 * M_PI / 4 };
+	unsigned int n, j, k;
+
+	for (n = 0; n + 1 < len; n += 2) {
+		gen->phase += dphi[(bits[n] << 1) | bits[n + 1]];
+		if (gen->phase > (float)M_PI)
+			gen->phase -= 2 * (float)M_PI;
+		else if (gen->phase < -(float)M_PI)
+			gen->phase += 2 * (float)M_PI;
+
+		memmove(&gen->hist_i[1], &gen->hist_i[0], TETRA_GEN_RRC_SYMS * sizeof(float));
+		memmove(&gen->hist_q[1], &gen->hist_q[0], TETRA_GEN_RRC_SYMS * sizeof(float));
+		gen->hist_i[0] = cosf(gen->phase);
+		gen->hist_q[0] = sinf(gen->phase);
+
+		/* polyphase interpolation, phase k uses taps k, k+SPS, ... */
+		for (k = 0; k < TETRA_GEN_SPS; k++) {
+			float si = 0, sq = 0;
+
+			for (j = 0; k + j * TETRA_GEN_SPS < TETRA_GEN_RRC_TAPS; j++) {
+				si += gen->hist_i[j] * gen->rrc[k + j * TETRA_GEN_SPS];
+				sq += gen->hist_q[j] * gen->rrc[k + j * TETRA_GEN_SPS];
+			}
+			*iq++ = si;
+			*iq++ = sq;
+		}
+	}
+}
@@ -0,0 +1,98 @@
+#ifndef TETRA_GEN_H
+#define TETRA_GEN_H
+
+/* Synthetic TETRA downlink generator.
+ *
+ * Builds the continuous downlink of one cell with the burst builders and
+ * channel coding of the decoder: sync bursts with SYNC and SYSINFO in
+ * frame 18, null MAC-RESOURCE PDUs on the control slots and TCH/S on the
+ * traffic slots. Bursts follow the TDMA time, so the output can run for
+ * any number of hyperframes. The modulator turns bursts into pi/4-DQPSK
+ * IQ at TETRA_GEN_SAMPLE_RATE, the rate the demodulator expects. */
+
+#include <stdint.h>
+
+#include <tetra_tdma.h>
+
+#define TETRA_GEN_BURST_BITS	510
+#define TETRA_GEN_SPS		2
+#define TETRA_GEN_SAMPLE_RATE	36000
+/* complex samples per burst */
+#define TETRA_GEN_BURST_SAMPLES	(TETRA_GEN_BURST_BITS / 2 * TETRA_GEN_SPS)
+/* coded TCH/S bits per traffic burst, one bit per byte in the voice payload */
+#define TETRA_GEN_VOICE_BITS	432
+
+/* RRC transmit filter: roll-off and length in symbols */
+#define TETRA_GEN_RRC_ALPHA	0.35f
+#define TETRA_GEN_RRC_SYMS	16
+#define TETRA_GEN_RRC_TAPS	(TETRA_GEN_RRC_SYMS * TETRA_GEN_SPS + 1)
+
+/* bs_service_details bits of D-MLE-SYSINFO, 18.5.2 */
+enum tetra_gen_service {
+	TETRA_GEN_SRV_REG		= (1 << 11),
+	TETRA_GEN_SRV_DEREG		= (1 << 10),
+	TETRA_GEN_SRV_PRIORITY_CELL	= (1 << 9),
+	TETRA_GEN_SRV_NEVER_MIN_MODE	= (1 << 8),
+	TETRA_GEN_SRV_MIGRATION		= (1 << 7),
+	TETRA_GEN_SRV_NORMAL_MODE	= (1 << 6),
+	TETRA_GEN_SRV_VOICE		= (1 << 5),
+	TETRA_GEN_SRV_CIRCUIT_DATA	= (1 << 4),
+	TETRA_GEN_SRV_SNDCP		= (1 << 2),
+	TETRA_GEN_SRV_AIR_ENCR		= (1 << 1),
+	TETRA_GEN_SRV_ADV_LINK		= (1 << 0),
+};
+
+struct tetra_gen_cfg {
+	uint16_t mcc;
+	uint16_t mnc;
+	uint8_t colour_code;
+	uint8_t system_code;
+	uint16_t la;
+	uint32_t dl_freq;		/* Hz, sent as carrier/band/offset in SYSINFO */
+	uint16_t service_details;	/* enum tetra_gen_service */
+	uint16_t hyperframe;		/* hyperframe number of the first burst */
+
+	/* traffic slots, bit n = timeslot n+1. They carry TCH/S in frames 1..17
+	 * and announce it with the DL usage marker usage_marker[n] (4..63) */
+	uint8_t traffic_mask;
+	uint8_t usage_marker[4];
+
+	/* coded TCH/S blocks, 'voice_frames' * TETRA_GEN_VOICE_BITS bits one
+	 * per byte, used in a loop. NULL sends pseudo random blocks */
+	const uint8_t *voice;
+	unsigned int voice_frames;
+	uint32_t seed;
+};
+
+struct tetra_gen {
+	struct tetra_gen_cfg cfg;
+	struct tetra_tdma_time time;	/* time of the next burst */
+	uint32_t scramb_init;
+	unsigned int voice_pos;
+	uint32_t prbs;
+
+	/* modulator */
+	float phase;
+	float rrc[TETRA_GEN_RRC_TAPS];
+	float hist_i[TETRA_GEN_RRC_SYMS + 1];
+	float hist_q[TETRA_GEN_RRC_SYMS + 1];
+};
+
+/* fill 'cfg' with a plausible cell: MCC/MNC 901/9999, CC 1, one traffic slot */
+void tetra_gen_cfg_default(struct tetra_gen_cfg *cfg);
+
+/* returns 0 or -EINVAL for a configuration the PDUs cannot carry */
+int tetra_gen_init(struct tetra_gen *gen, const struct tetra_gen_cfg *cfg);
+
+/* build the next burst into 'bits' (TETRA_GEN_BURST_BITS) and advance the
+ * TDMA time. 'time' (may be NULL) gets the time of the burst. Returns the
+ * burst type: TETRA_TRAIN_SYNC, TETRA_TRAIN_NORM_1 (TCH) or
+ * TETRA_TRAIN_NORM_2 (two half slot blocks) */
+int tetra_gen_burst(struct tetra_gen *gen, uint8_t *bits, struct tetra_tdma_time *time);
+
+/* modulate 'len' bits (even) to len/2*TETRA_GEN_SPS interleaved I/Q floats
+ * pairs. The modulator state carries over, so consecutive calls give a
+ * continuous signal delayed by TETRA_GEN_RRC_SYMS/2 symbols */
+void tetra_gen_modulate(struct tetra_gen *gen, const uint8_t *bits, unsigned int len, float *iq);
+
+#endif /* TETRA_GEN_H */
@@ -0,0 +1,52 @@
+/* Packed bit string helpers, see tetra_pbits.h for the layout */
+
+#include <stdint.h>
+
+#include "tetra_pbits.h"
+
+void pbits_pack(uint64_t *out, const uint8_t *ubits, unsigned int len)
+{
+	unsigned int i, j, n;
+	uint64_t w;
+
+	for (i = 0; i < len; i += 64) {
+		n = (len - i < 64) ? len - i : 64;
+		w = 0;
+		for (j = 0; j < n; j++)
+			w = (w << 1) | (ubits[i + j] & 1);
+		out[i / 64] = w << (64 - n);
+	}
+}
+
+void pbits_unpack(uint8_t *ubits, const uint64_t *in, unsigned int offs, unsigned int len)
+{
+	unsigned int i, j, n;
+	uint64_t w;
+
+	for (i = 0; i < len; i += 64) {
+		n = (len - i < 64) ? len - i : 64;
+		w = pbits_get(in, offs + i, n) << (64 - n);
+		for (j = 0; j < n; j++) {
+			ubits[i + j] = w >> 63;
+			w <<= 1;
+		}
+	}
+}
+
+void pbits_copy(uint64_t *dst, unsigned int doffs, const uint64_t *src, unsigned int soffs, unsigned int len)
+{
+	unsigned int i, n;
+
+	for (i = 0; i < len; i += 64) {
+		n = (len - i < 64) ? len - i : 64;
+		pbits_put(dst, doffs + i, pbits_get(src, soffs + i, n), n);
+	}
+}
+
+void pbits_xor(uint64_t *dst, const uint64_t *src, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i < PBITS_WORDS(len); i++)
+		dst[i] ^= src[i];
+}
@@ -0,0 +1,57 @@
+#ifndef TETRA_PBITS_H
+#define TETRA_PBITS_H
+
+/* Packed bit strings: 64 bits per word, first bit in the MSB of word 0.
+ * Bit 'n' of a string lives in word n/64 at bit 63 - n%64. Bits past the
+ * end of the string in the last word are don't care unless noted. */
+
+#include <stdint.h>
+
+#define PBITS_WORDS(bits)	(((bits) + 63) / 64)
+
+/* pack 'len' unpacked bits (one per byte, LSB used), unused bits of the last word are zeroed */
+void pbits_pack(uint64_t *out, const uint8_t *ubits, unsigned int len);
+
+/* unpack 'len' bits starting at bit 'offs' into one bit per byte */
+void pbits_unpack(uint8_t *ubits, const uint64_t *in, unsigned int offs, unsigned int len);
+
+/* extract 'len' (up to 64) bits at bit 'offs', the first bit ends up as the MSB of the result */
+static inline uint64_t pbits_get(const uint64_t *in, unsigned int offs, unsigned int len)
+{
+	unsigned int w = offs / 64, b = offs % 64;
+	uint64_t v;
+
+	if (!len)
+		return 0;
+	v = in[w] << b;
+	if (b + len > 64)
+		v |= in[w + 1] >> (64 - b);
+	return v >> (64 - len);
+}
+
+/* store the low 'len' (up to 64) bits of 'val' at bit 'offs', other bits are kept */
+static inline void pbits_put(uint64_t *out, unsigned int offs, uint64_t val, unsigned int len)
+{
+	unsigned int w = offs / 64, b = offs % 64;
+	uint64_t mask;
+
+	if (!len)
+		return;
+	mask = (len == 64) ? ~(uint64_t)0 : (((uint64_t)1 << len) - 1);
+	val &= mask;
+	out[w] = (out[w] & ~((mask << (64 - len)) >> b)) | ((val << (64 - len)) >> b);
+	if (b + len > 64) {
+		unsigned int s = 128 - b - len;
+
+		out[w + 1] = (out[w + 1] & ~(mask << s)) | (val << s);
+	}
+}
+
+/* copy 'len' bits from 'src' at 'soffs' to 'dst' at 'doffs', a word at a time */
+void pbits_copy(uint64_t *dst, unsigned int doffs, const uint64_t *src, unsigned int soffs, unsigned int len);
+
+/* dst ^= src over the first 'len' bits, both strings start at bit 0.
+ * Whole words are processed, so the padding of the last word is XORed too */
+void pbits_xor(uint64_t *dst, const uint64_t *src, unsigned int len);
+
+#endif /* TETRA_PBITS_H */
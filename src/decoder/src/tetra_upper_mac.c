@@ -38,22 +38,22 @@
 /* FIXME move global fragslots to context variable */
 // struct fragslot fragslots[FRAGSLOT_NR_SLOTS] = {0};
 
-void init_fragslot(struct fragslot *fragslot)
+void init_fragslot(struct msgb_pool *pool, struct fragslot *fragslot)
 {
 	if (fragslot->msgb) {
 		/* Should never be the case, but just to be sure */
 		// talloc_free(fragslot->msgb);
-		free(fragslot->msgb);
+		msgb_pool_release(pool, fragslot->msgb);
 		memset(fragslot, 0, sizeof(struct fragslot));
 	}
-	fragslot->msgb = msgb_alloc(FRAGSLOT_MSGB_SIZE, "fragslot");
+	fragslot->msgb = msgb_pool_alloc(pool, FRAGSLOT_MSGB_SIZE, "fragslot");
 }
 
-void cleanup_fragslot(struct fragslot *fragslot)
+void cleanup_fragslot(struct msgb_pool *pool, struct fragslot *fragslot)
 {
 	if (fragslot->msgb) {
 		// talloc_free(fragslot->msgb);
-		free(fragslot->msgb);
+		msgb_pool_release(pool, fragslot->msgb);
 	}
 	memset(fragslot, 0, sizeof(struct fragslot));
 }
@@ -66,7 +66,7 @@ void age_fragslots(struct tetra_mac_state *tms)
 			tms->fragslots[i].age++;
 			if (tms->fragslots[i].age > N203) {
 				// printf("\nFRAG: aged out old fragments for slot=%d fragments=%d length=%d timer=%d\n", i, tms->fragslots[i].num_frags, tms->fragslots[i].length, tms->fragslots[i].age);
-				cleanup_fragslot(&tms->fragslots[i]);
+				cleanup_fragslot(&tms->msgb_pool, &tms->fragslots[i]);
 			}
 		}
 	}
@@ -175,7 +175,7 @@ static int rx_bcast(struct tetra_tmvsap_prim *tmvp, struct tetra_mac_state *tms)
 
 const char *tetra_alloc_dump(const struct tetra_chan_alloc_decoded *cad, struct tetra_mac_state *tms)
 {
-	static char buf[64];
+	static __thread char buf[64];
 	char *cur = buf;
 	unsigned int freq_band, freq_offset;
 
@@ -227,7 +227,7 @@ static int rx_resrc(struct tetra_tmvsap_prim *tmvp, struct tetra_mac_state *tms)
 	}
 
 	/* Decrypt buffer if encrypted and key available */
-	if (rsd.is_encrypted && tcdb->num_keys) {
+	if (rsd.is_encrypted && tcs->tcdb->num_keys) {
 		decrypt_identity(tcs, &rsd.addr);
 		key = get_ksg_key(tcs, rsd.addr.ssi);
 
@@ -268,6 +268,9 @@ static int rx_resrc(struct tetra_tmvsap_prim *tmvp, struct tetra_mac_state *tms)
 	tms->ssi = rsd.addr.ssi;
 	tms->usage_marker = rsd.addr.usage_marker;
 	tms->addr_type = rsd.addr.type;
+	/* the talkgroup (or individual) the traffic with this marker belongs to */
+	if (rsd.addr.type == ADDR_TYPE_SSI_USAGE && !rsd.is_encrypted)
+		tms->usage_marker_ssi[rsd.addr.usage_marker & 0x3f] = rsd.addr.ssi;
 
 	if (msgb_l2len(msg) == 0)
 		goto out; /* No l2 data */
@@ -285,10 +288,10 @@ static int rx_resrc(struct tetra_tmvsap_prim *tmvp, struct tetra_mac_state *tms)
 		slot = tmvp->u.unitdata.tdma_time.tn;
 		if (tms->fragslots[slot].active) {
 			// printf("\nWARNING: fragment slot still active\n");
-			cleanup_fragslot(&tms->fragslots[slot]);
+			cleanup_fragslot(&tms->msgb_pool, &tms->fragslots[slot]);
 		}
 
-		init_fragslot(&tms->fragslots[slot]);
+		init_fragslot(&tms->msgb_pool, &tms->fragslots[slot]);
 		fragmsgb = tms->fragslots[slot].msgb;
 
 		/* Copy l2 part to fragmsgb. l3h is constructed once all fragments are merged */
@@ -425,7 +428,7 @@ static int rx_macend(struct tetra_tmvsap_prim *tmvp, struct tetra_mac_state *tms
 		// printf("FRAG: got end frag with len %d without start packet for slot=%d\n", length_indicator * 8, slot);
 	}
 
-	cleanup_fragslot(&tms->fragslots[slot]);
+	cleanup_fragslot(&tms->msgb_pool, &tms->fragslots[slot]);
 	return length_indicator * 8;
 }
 
@@ -532,8 +535,15 @@ static int rx_tmv_unitdata_ind(struct tetra_tmvsap_prim *tmvp, struct tetra_mac_
 		// tetra_get_lchan_name(tup->lchan),
 		// tup->crc_ok, pdu_name);
 
-	if (!tup->crc_ok)
+	if (!tup->crc_ok) {
+		/* without the ACCESS-ASSIGN the slot content is unknown, don't feed it to the codec */
+		if (tup->lchan == TETRA_LC_AACH) {
+			tms->cur_burst.is_traffic = 0;
+			tms->cur_burst.blk1_stolen = false;
+			tms->cur_burst.blk2_stolen = false;
+		}
 		return -1;
+	}
 
 
 	if (tup->tdma_time.fn == 18 && REASSEMBLE_FRAGMENTS)
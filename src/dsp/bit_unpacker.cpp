@@ -2,6 +2,14 @@
 
 namespace dsp {
     int BitUnpacker::process(int count, const uint8_t* in, uint8_t* out) {
+        if(softBits) {
+            //Sign-extend each nibble and scale -7..7 to -126..126
+            for(int i = 0; i < count; i++) {
+                out[(i * 2)] = (uint8_t)(((int8_t)(in[i] & 0xF0) >> 4) * 18);
+                out[(i * 2) + 1] = (uint8_t)(((int8_t)(in[i] << 4) >> 4) * 18);
+            }
+            return count*2;
+        }
         for(int i = 0; i < count; i++) {
             out[(i * 2) + 1] = in[i] & 0b01;
             out[(i * 2)] = (in[i] & 0b10) >> 1;
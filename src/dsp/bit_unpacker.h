@@ -13,6 +13,7 @@
 
 namespace dsp {
     //Unpack 2bits/byte to 1, because tetra-rx wants it
+    //In soft mode the input holds two 4-bit soft bits per byte and the output is one int8_t soft bit per byte(+127 = 0, -127 = 1)
     class BitUnpacker : public Processor<uint8_t, uint8_t> {
         using base_type = Processor<uint8_t, uint8_t>;
     public:
@@ -30,6 +31,17 @@ namespace dsp {
             return outCount;
         }
 
+        void setSoftBits(bool soft) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            softBits = soft;
+            base_type::tempStart();
+        }
+
         int process(int count, const uint8_t* in, uint8_t* out);
+
+    private:
+        bool softBits = false;
     };
 }
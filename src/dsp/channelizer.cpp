@@ -0,0 +1,231 @@
+#include "channelizer.h"
+#include <volk/volk.h>
+
+namespace dsp {
+    namespace multirate {
+        PolyphaseChannelizer::~PolyphaseChannelizer() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            for (auto& ch : channels) {
+                buffer::free(ch->pfbBuf);
+                delete ch;
+            }
+            channels.clear();
+            destroy();
+        }
+
+        void PolyphaseChannelizer::init(stream<complex_t>* in, double samplerate, double channelSpacing, double outSamplerate) {
+            _samplerate = samplerate;
+            _channelSpacing = channelSpacing;
+            _outSamplerate = outSamplerate;
+            generate();
+            base_type::init(in);
+        }
+
+        void PolyphaseChannelizer::setSamplerate(double samplerate) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            checkOffsets(channelCount(samplerate, _channelSpacing));
+            base_type::tempStop();
+            _samplerate = samplerate;
+            destroy();
+            generate();
+            base_type::tempStart();
+        }
+
+        void PolyphaseChannelizer::setChannelSpacing(double channelSpacing) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            checkOffsets(channelCount(_samplerate, channelSpacing));
+            base_type::tempStop();
+            _channelSpacing = channelSpacing;
+            destroy();
+            generate();
+            base_type::tempStart();
+        }
+
+        void PolyphaseChannelizer::bindChannel(int offset, stream<complex_t>* stream) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            if (offset < -(_channels / 2) || offset >= _channels / 2) {
+                throw std::runtime_error("[PolyphaseChannelizer] Channel offset out of range");
+            }
+
+            // Check that the stream isn't already bound
+            for (auto& ch : channels) {
+                if (ch->out == stream) {
+                    throw std::runtime_error("[PolyphaseChannelizer] Tried to bind stream to that is already bound");
+                }
+            }
+
+            base_type::tempStop();
+            Channel* ch = new Channel;
+            ch->offset = offset;
+            ch->bin = ((offset % _channels) + _channels) % _channels;
+            ch->out = stream;
+            ch->pfbBuf = buffer::alloc<complex_t>(CHANNELIZER_BLOCK_SIZE);
+            ch->resamp.init(NULL, 2.0 * getChannelSpacing(), _outSamplerate);
+            ch->resamp.out.free();
+            ch->written = 0;
+            base_type::registerOutput(stream);
+            channels.push_back(ch);
+            base_type::tempStart();
+        }
+
+        void PolyphaseChannelizer::unbindChannel(stream<complex_t>* stream) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            auto it = std::find_if(channels.begin(), channels.end(), [stream](Channel* ch) { return ch->out == stream; });
+            if (it == channels.end()) {
+                throw std::runtime_error("[PolyphaseChannelizer] Tried to unbind stream that isn't bound");
+            }
+
+            base_type::tempStop();
+            base_type::unregisterOutput(stream);
+            buffer::free((*it)->pfbBuf);
+            delete *it;
+            channels.erase(it);
+            base_type::tempStart();
+        }
+
+        int PolyphaseChannelizer::getWritten(stream<complex_t>* stream) {
+            auto it = std::find_if(channels.begin(), channels.end(), [stream](Channel* ch) { return ch->out == stream; });
+            if (it == channels.end()) {
+                throw std::runtime_error("[PolyphaseChannelizer] Tried to get the output count of a stream that isn't bound");
+            }
+            return (*it)->written;
+        }
+
+        int PolyphaseChannelizer::channelCount(double samplerate, double channelSpacing) {
+            //Even channel count is required for the M/2 decimation
+            int count = std::max<int>(2, (int)round(samplerate / channelSpacing));
+            return count + (count & 1);
+        }
+
+        void PolyphaseChannelizer::checkOffsets(int channels) {
+            for (auto& ch : this->channels) {
+                if (ch->offset < -(channels / 2) || ch->offset >= channels / 2) {
+                    throw std::runtime_error("[PolyphaseChannelizer] Bound channel offset out of range for the new channel count");
+                }
+            }
+        }
+
+        void PolyphaseChannelizer::generate() {
+            _channels = channelCount(_samplerate, _channelSpacing);
+            _decim = _channels / 2;
+
+            //Prototype lowpass passes the whole channel plus some margin for the demodulator filters, like the single channel VFO does
+            double spacing = getChannelSpacing();
+            tap<float> proto = taps::lowPass(spacing * 0.6, spacing * 0.2, _samplerate);
+            _branchTaps = (proto.size + _channels - 1) / _channels;
+            //Branch r takes the input r samples back, so for a given tap index p the branches read M contiguous samples in reversed order
+            branchTaps = buffer::alloc<float>(_channels * _branchTaps);
+            for (int p = 0; p < _branchTaps; p++) {
+                for (int j = 0; j < _channels; j++) {
+                    int i = (p * _channels) + (_channels - 1 - j);
+                    branchTaps[(p * _channels) + j] = (i < proto.size) ? proto.taps[i] : 0.0f;
+                }
+            }
+            taps::free(proto);
+            branchAcc = buffer::alloc<complex_t>(_channels);
+            branchProd = buffer::alloc<complex_t>(_channels);
+
+            histLen = (_channels * _branchTaps) - 1;
+            buffer = buffer::alloc<complex_t>(histLen + STREAM_BUFFER_SIZE);
+            buffer::clear(buffer, histLen);
+            offset = 0;
+            flip = false;
+
+            fftIn = fftwf_alloc_complex(_channels);
+            fftOut = fftwf_alloc_complex(_channels);
+            plan = fftwf_plan_dft_1d(_channels, fftIn, fftOut, FFTW_BACKWARD, FFTW_ESTIMATE);
+
+            for (auto& ch : channels) {
+                ch->bin = ((ch->offset % _channels) + _channels) % _channels;
+                ch->resamp.setInSamplerate(2.0 * spacing);
+            }
+        }
+
+        void PolyphaseChannelizer::destroy() {
+            fftwf_destroy_plan(plan);
+            fftwf_free(fftIn);
+            fftwf_free(fftOut);
+            buffer::free(branchTaps);
+            buffer::free(branchAcc);
+            buffer::free(branchProd);
+            buffer::free(buffer);
+            plan = NULL;
+            fftIn = NULL;
+            fftOut = NULL;
+            branchTaps = NULL;
+            branchAcc = NULL;
+            branchProd = NULL;
+            buffer = NULL;
+        }
+
+        void PolyphaseChannelizer::flushChannels(int count) {
+            if (!count) { return; }
+            for (auto& ch : channels) {
+                ch->written += ch->resamp.process(count, ch->pfbBuf, &ch->out->writeBuf[ch->written]);
+            }
+        }
+
+        int PolyphaseChannelizer::process(int count, const complex_t* in) {
+            memcpy(&buffer[histLen], in, count * sizeof(complex_t));
+            for (auto& ch : channels) {
+                ch->written = 0;
+            }
+
+            // One filterbank output every M/2 input samples
+            int outCount = 0;
+            complex_t* fin = (complex_t*)fftIn;
+            complex_t* fout = (complex_t*)fftOut;
+            for (; offset < count; offset += _decim) {
+                // All branches at once, one tap index at a time: branchAcc[j] is branch M-1-j
+                const complex_t* oldest = &buffer[histLen + offset - (_channels - 1)];
+                volk_32fc_32f_multiply_32fc((lv_32fc_t*)branchAcc, (lv_32fc_t*)oldest, branchTaps, _channels);
+                for (int p = 1; p < _branchTaps; p++) {
+                    volk_32fc_32f_multiply_32fc((lv_32fc_t*)branchProd, (lv_32fc_t*)(oldest - (p * _channels)), &branchTaps[p * _channels], _channels);
+                    volk_32f_x2_add_32f((float*)branchAcc, (float*)branchAcc, (float*)branchProd, _channels * 2);
+                }
+                for (int r = 0; r < _channels; r++) {
+                    fin[r] = branchAcc[_channels - 1 - r];
+                }
+                fftwf_execute(plan);
+
+                // Shifting by M/2 samples between outputs flips the sign of odd bins on every other output
+                for (auto& ch : channels) {
+                    complex_t v = fout[ch->bin];
+                    ch->pfbBuf[outCount] = (flip && (ch->bin & 1)) ? complex_t{ -v.re, -v.im } : v;
+                }
+                flip = !flip;
+
+                if (++outCount == CHANNELIZER_BLOCK_SIZE) {
+                    flushChannels(outCount);
+                    outCount = 0;
+                }
+            }
+            flushChannels(outCount);
+            offset -= count;
+
+            // Keep the filter history for the next call
+            memmove(buffer, &buffer[count], histLen * sizeof(complex_t));
+            return count;
+        }
+
+        int PolyphaseChannelizer::run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            process(count, base_type::_in->readBuf);
+
+            base_type::_in->flush();
+            for (auto& ch : channels) {
+                if (ch->written && !ch->out->swap(ch->written)) { return -1; }
+            }
+            return count;
+        }
+    }
+}
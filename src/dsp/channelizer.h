@@ -0,0 +1,85 @@
+#pragma once
+#include <dsp/sink.h>
+#include <dsp/taps/low_pass.h>
+#include <dsp/multirate/rational_resampler.h>
+#include <fftw3.h>
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+//Max PFB output samples per channel between two resampler calls
+#define CHANNELIZER_BLOCK_SIZE 4096
+
+namespace dsp {
+    namespace multirate {
+        //2x oversampled polyphase FFT channelizer: splits one wideband stream into channels spaced samplerate/M apart,
+        //every bound channel is resampled from 2*spacing to outSamplerate. Channel 0 is centered on the input, negative offsets are below it
+        class PolyphaseChannelizer : public Sink<complex_t> {
+            using base_type = Sink<complex_t>;
+        public:
+            PolyphaseChannelizer() {}
+
+            PolyphaseChannelizer(stream<complex_t>* in, double samplerate, double channelSpacing, double outSamplerate) { init(in, samplerate, channelSpacing, outSamplerate); }
+
+            ~PolyphaseChannelizer();
+
+            void init(stream<complex_t>* in, double samplerate, double channelSpacing, double outSamplerate);
+
+            void setSamplerate(double samplerate);
+            void setChannelSpacing(double channelSpacing);
+
+            //Channel offset is in multiples of the channel spacing, -M/2..M/2-1. Offsets outside that range throw
+            void bindChannel(int offset, stream<complex_t>* stream);
+            void unbindChannel(stream<complex_t>* stream);
+
+            //Samples the last process() call wrote to the writeBuf of a bound stream
+            int getWritten(stream<complex_t>* stream);
+
+            int getChannelCount() { return _channels; }
+            double getChannelSpacing() { return _samplerate / (double)_channels; }
+
+            int run();
+
+            //Runs the filterbank on 'count' input samples, the output of every bound channel goes to its writeBuf
+            int process(int count, const complex_t* in);
+
+        protected:
+            struct Channel {
+                int offset;
+                int bin;
+                stream<complex_t>* out;
+                complex_t* pfbBuf;
+                RationalResampler<complex_t> resamp;
+                int written;
+            };
+
+            static int channelCount(double samplerate, double channelSpacing);
+            void checkOffsets(int channels);
+            void generate();
+            void destroy();
+            void flushChannels(int count);
+
+            double _samplerate;
+            double _channelSpacing;
+            double _outSamplerate;
+
+            int _channels = 0; // M
+            int _decim = 0; // M/2
+            int _branchTaps = 0; // Taps per polyphase branch
+            float* branchTaps = NULL; // [P][M], branch order reversed: branchTaps[p*M + j] = h[p*M + M-1-j]
+            complex_t* branchAcc = NULL; // Branch outputs in reversed order
+            complex_t* branchProd = NULL;
+            complex_t* buffer = NULL;
+            int histLen = 0;
+            int offset = 0;
+            bool flip = false;
+
+            fftwf_complex* fftIn = NULL;
+            fftwf_complex* fftOut = NULL;
+            fftwf_plan plan = NULL;
+
+            std::vector<Channel*> channels;
+        };
+    }
+}
@@ -6,6 +6,7 @@ namespace dsp {
             if (!base_type::_block_init) { return; }
             base_type::stop();
             dsp::multirate::freePolyphaseBank(interpBank);
+            dsp::multirate::freePolyphaseBank(derivBank);
             buffer::free(buffer);
         }
 
@@ -68,6 +69,7 @@ namespace dsp {
             _interpPhaseCount = interpPhaseCount;
             _interpTapCount = interpTapCount;
             dsp::multirate::freePolyphaseBank(interpBank);
+            dsp::multirate::freePolyphaseBank(derivBank);
             buffer::free(buffer);
             generateInterpTaps();
             buffer = buffer::alloc<complex_t>(STREAM_BUFFER_SIZE + _interpTapCount);
@@ -75,6 +77,12 @@ namespace dsp {
             base_type::tempStart();
         }
 
+        void COMPLEX_FD::setFusedTed(bool fused) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            _fusedTed = fused;
+        }
+
         void COMPLEX_FD::reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
@@ -86,6 +94,19 @@ namespace dsp {
             base_type::tempStart();
         }
 
+        // Both dot products in one pass, the input is read only once
+        static inline void dotProd2(complex_t* out, complex_t* dout, const complex_t* in, const float* taps, const float* dtaps, int count) {
+            float re = 0.0f, im = 0.0f, dre = 0.0f, dim = 0.0f;
+            for (int i = 0; i < count; i++) {
+                re += in[i].re * taps[i];
+                im += in[i].im * taps[i];
+                dre += in[i].re * dtaps[i];
+                dim += in[i].im * dtaps[i];
+            }
+            *out = { re, im };
+            *dout = { dre, dim };
+        }
+
         int COMPLEX_FD::process(int count, const complex_t* in, complex_t* out) {
             // Copy data to work buffer
             memcpy(bufStart, in, count * sizeof(complex_t));
@@ -99,32 +120,23 @@ namespace dsp {
 
                 // Calculate new output value
                 int phase = std::clamp<int>(floorf(pcl.phase * (float)_interpPhaseCount), 0, _interpPhaseCount - 1);
-                volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&outVal, (lv_32fc_t*)&buffer[offset], interpBank.phases[phase], _interpTapCount);
-                out[outCount++] = outVal;
-
                 if(_spsctr == 0) {
-                    // Calculate derivative of the signal
-                    if (phase == 0) {
-                        complex_t fT1;
-                        volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&fT1, (lv_32fc_t*)&buffer[offset], interpBank.phases[phase+1], _interpTapCount);
-                        dfdt = fT1 - outVal;
-                    }
-                    else if (phase == _interpPhaseCount - 1) {
-                        complex_t fT_1;
-                        volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&fT_1, (lv_32fc_t*)&buffer[offset], interpBank.phases[phase-1], _interpTapCount);
-                        dfdt = outVal - fT_1;
+                    // Calculate the output and the derivative of the signal at the same phase
+                    if (_fusedTed) {
+                        dotProd2(&outVal, &dfdt, &buffer[offset], interpBank.phases[phase], derivBank.phases[phase], _interpTapCount);
                     }
                     else {
-                        complex_t fT_1;
-                        complex_t fT1;
-                        volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&fT1, (lv_32fc_t*)&buffer[offset], interpBank.phases[phase+1], _interpTapCount);
-                        volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&fT_1, (lv_32fc_t*)&buffer[offset], interpBank.phases[phase-1], _interpTapCount);
-                        dfdt = (fT1 - fT_1) * 0.5f;
+                        volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&outVal, (lv_32fc_t*)&buffer[offset], interpBank.phases[phase], _interpTapCount);
+                        volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&dfdt, (lv_32fc_t*)&buffer[offset], derivBank.phases[phase], _interpTapCount);
                     }
+                    out[outCount++] = outVal;
+
                     // Calculate error
                     // error = ((outVal.re * dfdt.re) + (outVal.im * dfdt.im));
                     error = (((outVal.re > 0 ? 1.0f : -1.0f) * dfdt.re) + ((outVal.im > 0 ? 1.0f : -1.0f) * dfdt.im));
                 } else {
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&outVal, (lv_32fc_t*)&buffer[offset], interpBank.phases[phase], _interpTapCount);
+                    out[outCount++] = outVal;
                     error = 0;
                 }
                 _spsctr++;
@@ -154,6 +166,17 @@ namespace dsp {
             double bw = 0.5 / (double)_interpPhaseCount;
             dsp::tap<float> lp = dsp::taps::windowedSinc<float>(_interpPhaseCount * _interpTapCount, dsp::math::hzToRads(bw, 1.0), dsp::window::nuttall, _interpPhaseCount);
             interpBank = dsp::multirate::buildPolyphaseBank<float>(_interpPhaseCount, lp);
+
+            // Central difference of the prototype, one prototype tap is one phase step. The bank stores
+            // phases in reverse prototype order, so the next phase is the previous prototype tap
+            dsp::tap<float> dlp = taps::alloc<float>(lp.size);
+            for (int i = 0; i < lp.size; i++) {
+                float prev = (i > 0) ? lp.taps[i - 1] : 0.0f;
+                float next = (i < lp.size - 1) ? lp.taps[i + 1] : 0.0f;
+                dlp.taps[i] = (prev - next) * 0.5f;
+            }
+            derivBank = dsp::multirate::buildPolyphaseBank<float>(_interpPhaseCount, dlp);
+            taps::free(dlp);
             taps::free(lp);
         }
     }
@@ -36,6 +36,8 @@ namespace dsp {
             void setMuGain(double muGain);
             void setOmegaRelLimit(double omegaRelLimit);
             void setInterpParams(int interpPhaseCount, int interpTapCount);
+            //Evaluate the interpolant and its derivative in one pass over the input instead of two dot products
+            void setFusedTed(bool fused);
             void reset();
 
             int process(int count, const complex_t* in, complex_t* out);
@@ -59,6 +61,8 @@ namespace dsp {
             void generateInterpTaps();
 
             dsp::multirate::PolyphaseBank<float> interpBank;
+            //Derivative of the interpolation filter with the same phases, so the TED needs no neighbouring phases
+            dsp::multirate::PolyphaseBank<float> derivBank;
 
             double _omega;
             int _outSps;
@@ -68,6 +72,7 @@ namespace dsp {
             double _omegaRelLimit;
             int _interpPhaseCount;
             int _interpTapCount;
+            bool _fusedTed = true;
 
             int offset = 0;
             complex_t* buffer;
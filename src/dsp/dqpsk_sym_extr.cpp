@@ -1,55 +1,120 @@
 #include "dqpsk_sym_extr.h"
+#include <algorithm>
+#include <volk/volk.h>
 
 namespace dsp {
+    //Round to nearest even instead of roundf, which has no vector instruction
+    static inline int quantizeSoft(float v) {
+        return (int)nearbyintf(std::clamp<float>(v * SOFT_BIT_SCALE, -7.0f, 7.0f));
+    }
+
+    //Remap phase diffs to actual tetra symbols(swap 0b10 and 0b11): 0, pi/2, pi, -pi/2. Computed instead of a table lookup, so the loop vectorizes
+    static inline uint8_t phaseDiffToSym(uint8_t diff) {
+        return diff ^ (diff >> 1);
+    }
+
+    //atan(x) for 0 <= x <= 1, max error ~0.004 rad
+    static inline float fastAtan01(float x) {
+        return x * (FL_M_PI / 4.0f) + 0.273f * x * (1.0f - x);
+    }
+
+    //This mapping is required to make substraction differential decoder work properly
+    static inline uint8_t quadrant(const complex_t& c) {
+        uint8_t a = std::signbit(c.im);
+        uint8_t b = std::signbit(c.re);
+        return (a << 1) | (a ^ b);
+    }
+
+    //Rotate the differential phase by -pi/4, so bit 0 decisions are Re>0 and Im<0
+    static inline uint8_t softSymbol(complex_t c, complex_t prev) {
+        complex_t diff = c * prev.conj();
+        complex_t w = {0.7071f * (diff.re + diff.im), 0.7071f * (diff.im - diff.re)};
+        return SOFT_SYM_PACK(quantizeSoft(w.re), quantizeSoft(-w.im));
+    }
+
     int DQPSKSymbolExtractor::process(int count, const complex_t* in, uint8_t* out) {
-        for(int i = 0; i < count; i++) {
-            complex_t sym_c = in[i];
-            bool a = sym_c.im<0;
-            bool b = sym_c.re<0;
-            complex_t ideal_sym = {b?-0.7071f : 0.7071f, a?-0.7071f : 0.7071f};
-            // float dist = fabsf(sqrtf(((ideal_sym.re-sym_c.re)*(ideal_sym.re-sym_c.re))+((ideal_sym.im-sym_c.im)*(ideal_sym.im-sym_c.im))));
-            float dist = std::abs(ideal_sym.phase() - sym_c.phase());
-            errorbuf[errorptr] = dist;
-            errorptr++;
-            if(errorptr >= SYNC_DETECT_BUF) {
-                errorptr = 0;
+        if(count <= 0) { return count; }
+
+        //Every symbol is decoded against the previous input symbol, so the loops carry no state and vectorize
+        if(softBits) {
+            out[0] = softSymbol(in[0], prevSym);
+            for(int i = 1; i < count; i++) {
+                out[i] = softSymbol(in[i], in[i - 1]);
+            }
+        } else {
+            out[0] = phaseDiffToSym((quadrant(in[0]) - prev) & 3);
+            for(int i = 1; i < count; i++) {
+                out[i] = phaseDiffToSym((quadrant(in[i]) - quadrant(in[i - 1])) & 3);
+            }
+        }
+        //Both references advance on every symbol, so toggling soft bits never decodes against a stale one
+        prevSym = in[count - 1];
+        prev = quadrant(in[count - 1]);
+
+        float dist[METRIC_TILE];
+        float inphase[METRIC_TILE];
+        float power[METRIC_TILE];
+        for(int t = 0; t < count; t += METRIC_TILE) {
+            int n = std::min<int>(count - t, METRIC_TILE);
+            const complex_t* sym = &in[t];
+
+            //Derotate by the ideal point of the quadrant (scaled by sqrt(2)): x is in-phase, y is quadrature error, |y| <= x
+            for(int j = 0; j < n; j++) {
+                float absre = fabsf(sym[j].re);
+                float absim = fabsf(sym[j].im);
+                float x = absre + absim;
+                float y = absim - absre;
+                //Phase distance to the ideal point, same metric as |ideal.phase() - sym.phase()| without the two atan2 calls
+                dist[j] = fastAtan01(fabsf(y) / std::max<float>(x, 1e-30f));
+                //Signal power is the squared mean in-phase amplitude, everything else is noise
+                inphase[j] = x;
+                power[j] = (x * x) + (y * y);
             }
-            errordisplayptr++;
-            if(errordisplayptr >= SYNC_DETECT_DISPLAY) {
-                float xerr = 0;
-                for(int i = 0; i < SYNC_DETECT_BUF; i++) {
-                    xerr+=errorbuf[i];
+
+            //Sums up to the next sync detector or SNR window boundary
+            for(int j = 0; j < n;) {
+                int len = std::min<int>(n - j, std::min<int>(SYNC_DETECT_DISPLAY - errordisplayptr, SNR_WINDOW - snrcount));
+                float sum;
+                volk_32f_accumulator_s32f(&sum, &dist[j], len);
+                errorBlockSum += sum;
+                volk_32f_accumulator_s32f(&sum, &inphase[j], len);
+                snrsig += sum;
+                volk_32f_accumulator_s32f(&sum, &power[j], len);
+                snrpow += sum;
+                j += len;
+                errordisplayptr += len;
+                snrcount += len;
+
+                //The detector averages the last SYNC_DETECT_BUF symbols, kept as sums of SYNC_DETECT_DISPLAY symbols
+                if(errordisplayptr >= SYNC_DETECT_DISPLAY) {
+                    errorsum += errorBlockSum - errorBlocks[errorptr];
+                    errorBlocks[errorptr] = errorBlockSum;
+                    errorptr = (errorptr + 1) % SYNC_DETECT_BLOCKS;
+                    errorBlockSum = 0;
+                    float xerr = (float)(errorsum / (double)SYNC_DETECT_BUF);
+                    standarderr = xerr;
+                    if(xerr >= 0.35f) {
+                        sync = false;
+                    } else {
+                        sync = true;
+                    }
+                    errordisplayptr = 0;
                 }
-                xerr /= (float)SYNC_DETECT_BUF;
-                standarderr = xerr;
-                if(xerr >= 0.35f) {
-                    sync = false;
-                } else {
-                    sync = true;
+
+                if(snrcount >= SNR_WINDOW) {
+                    double mean = snrsig / (double)SNR_WINDOW;
+                    double sig = mean * mean;
+                    double noise = (snrpow / (double)SNR_WINDOW) - sig;
+                    if(sig > 0.0) {
+                        noise = std::max<double>(noise, sig * 1e-6);
+                        snr = (float)(10.0 * log10(sig / noise));
+                        evm = (float)(100.0 * sqrt(noise / sig));
+                    }
+                    snrsig = 0;
+                    snrpow = 0;
+                    snrcount = 0;
                 }
-                errordisplayptr = 0;
-            }
-            uint8_t sym = ((a)<<1) | (a!=b); //This mapping is required to make substraction differential decoder work properly
-            uint8_t phaseDiff = (sym - prev + 4) % 4;
-            switch(phaseDiff) { //Remap phase diffs to actual tetra symbols(swap 0b10 and 0b11)
-                case 0b00:
-                    //0
-                    out[i] = 0b00;
-                    break;
-                case 0b01:
-                    //pi/2
-                    out[i]=0b01;
-                    break;
-                case 0b10:
-                    //pi
-                    out[i]=0b11;
-                    break;
-                case 0b11:
-                    //-pi/2
-                    out[i]=0b10;
-                    break;
             }
-            prev = sym;
         }
         return count;
     }
@@ -13,6 +13,14 @@
 
 #define SYNC_DETECT_BUF 4096
 #define SYNC_DETECT_DISPLAY 256
+#define SYNC_DETECT_BLOCKS (SYNC_DETECT_BUF / SYNC_DETECT_DISPLAY)
+#define SNR_WINDOW 255 // Symbols per SNR/EVM estimate, a timeslot long but not aligned to the bursts
+#define METRIC_TILE 256 // Symbols per pass of the metric loops
+#define SOFT_BIT_SCALE 8.5f
+
+// Soft mode: each output byte holds two signed 4-bit soft bits, first bit in the high nibble.
+// Positive value means bit 0, range -7..7
+#define SOFT_SYM_PACK(b0, b1) ((uint8_t)((((b0) & 0xF) << 4) | ((b1) & 0xF)))
 
 namespace dsp {
     //Symbol mapper + differential decoder
@@ -33,15 +41,33 @@ namespace dsp {
             return outCount;
         }
 
+        void setSoftBits(bool soft) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            softBits = soft;
+            base_type::tempStart();
+        }
+
         int process(int count, const complex_t* in, uint8_t* out);
 
         bool sync = false;
         float standarderr = 0;
+        // Decision-directed estimates over free-running SNR_WINDOW symbol windows, updated once per window
+        float snr = 0; // dB
+        float evm = 0; // %
 
     private:
         uint8_t prev = 0;
-        float errorbuf[SYNC_DETECT_BUF];
+        complex_t prevSym = {0.7071f, 0.7071f};
+        bool softBits = false;
+        float errorBlocks[SYNC_DETECT_BLOCKS] = {};
+        float errorBlockSum = 0;
+        double errorsum = 0;
         int errorptr = 0;
         int errordisplayptr = 0;
+        double snrsig = 0;
+        double snrpow = 0;
+        int snrcount = 0;
     };
 }
@@ -3,8 +3,9 @@
 namespace dsp {
     namespace loop {
             FLL::~FLL() {
-                taps::free(lbandedgerrcTaps);
-                taps::free(hbandedgerrcTaps);
+                taps::free(bandedgeReTaps);
+                taps::free(bandedgeImTaps);
+                buffer::free(bandedgeBuf);
             }
 
             void FLL::init(stream<complex_t>* in, double bandwidth, int sym_rate, int samp_rate, int filt_size, float filt_a, double initFreq, double minFreq, double maxFreq) {
@@ -14,10 +15,11 @@ namespace dsp {
                 _filt_size = filt_size;
                 _filt_a = filt_a;
 
-                //Create band-edge and normal filters
+                //Create band-edge filters and their delay line
                 createBandedgeFilters();
-                lbandedgerrc.init(NULL, lbandedgerrcTaps);
-                hbandedgerrc.init(NULL, hbandedgerrcTaps);
+                bandedgeBuf = buffer::alloc<complex_t>(STREAM_BUFFER_SIZE + _filt_size);
+                bandedgeBufStart = &bandedgeBuf[_filt_size - 1];
+                buffer::clear<complex_t>(bandedgeBuf, _filt_size - 1);
 
                 // Init phase control loop
                 float alpha, beta;
@@ -33,11 +35,9 @@ namespace dsp {
                 base_type::tempStop();
                 _symbolrate = symbolrate;
                 if(_samplerate/_symbolrate > 0.0f) {
-                    taps::free(lbandedgerrcTaps);
-                    taps::free(hbandedgerrcTaps);
+                    taps::free(bandedgeReTaps);
+                    taps::free(bandedgeImTaps);
                     createBandedgeFilters();
-                    lbandedgerrc.setTaps(lbandedgerrcTaps);
-                    hbandedgerrc.setTaps(hbandedgerrcTaps);
                 }
                 base_type::tempStart();
             }
@@ -48,11 +48,9 @@ namespace dsp {
                 base_type::tempStop();
                 _samplerate = samplerate;
                 if(_samplerate/_symbolrate > 0.0f) {
-                    taps::free(lbandedgerrcTaps);
-                    taps::free(hbandedgerrcTaps);
+                    taps::free(bandedgeReTaps);
+                    taps::free(bandedgeImTaps);
                     createBandedgeFilters();
-                    lbandedgerrc.setTaps(lbandedgerrcTaps);
-                    hbandedgerrc.setTaps(hbandedgerrcTaps);
                 }
                 base_type::tempStart();
             }
@@ -74,8 +72,8 @@ namespace dsp {
                     bb_taps.push_back(tap);
                 }
 
-                lbandedgerrcTaps = taps::alloc<complex_t>(_filt_size);
-                hbandedgerrcTaps = taps::alloc<complex_t>(_filt_size);
+                bandedgeReTaps = taps::alloc<float>(_filt_size);
+                bandedgeImTaps = taps::alloc<float>(_filt_size);
 
                 // Create the band edge filters by spinning the baseband
                 // filter up and down to the right places in frequency.
@@ -86,11 +84,11 @@ namespace dsp {
 
                     float k = (-N + (int)i) / (2.0f * sps);
 
+                    //Lower band-edge tap, the upper one is its conjugate
                     complex_t t1 = math::phasor(-2.0f * FL_M_PI * (1.0f + _filt_a) * k) * tap;
-                    complex_t t2 = math::phasor( 2.0f * FL_M_PI * (1.0f + _filt_a) * k) * tap;
 
-                    lbandedgerrcTaps.taps[_filt_size - i - 1] = t1;
-                    hbandedgerrcTaps.taps[_filt_size - i - 1] = t2;
+                    bandedgeReTaps.taps[_filt_size - i - 1] = t1.re;
+                    bandedgeImTaps.taps[_filt_size - i - 1] = t1.im;
                 }
             }
 
@@ -136,15 +134,19 @@ namespace dsp {
                 for (int i = 0; i < count; i++) {
                     complex_t shift = math::phasor(-pcl.phase);
                     complex_t x = in[i] * shift;
-                    complex_t lbe_out;
-                    complex_t hbe_out;
-                    lbandedgerrc.process(1, &(x), &lbe_out);
-                    hbandedgerrc.process(1, &(x), &hbe_out);
+                    bandedgeBufStart[i] = x;
+                    complex_t p, q;
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&p, (lv_32fc_t*)&bandedgeBuf[i], bandedgeReTaps.taps, _filt_size);
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&q, (lv_32fc_t*)&bandedgeBuf[i], bandedgeImTaps.taps, _filt_size);
+                    complex_t lbe_out = { p.re - q.im, p.im + q.re }; // P + jQ
+                    complex_t hbe_out = { p.re + q.im, p.im - q.re }; // P - jQ
                     float freqError = hbe_out.fastAmplitude() - lbe_out.fastAmplitude();
                     // dbg_last_err = pcl.freq;
                     pcl.advance(freqError);
                     out[i] = x;
                 }
+                // Keep the filter history for the next block
+                memmove(bandedgeBuf, &bandedgeBuf[count], (_filt_size - 1) * sizeof(complex_t));
                 return count;
             }
     }
@@ -56,10 +56,12 @@ namespace dsp {
             // float dbg_last_err = 0;
         protected:
             PhaseControlLoop<float> pcl;
-            tap<complex_t> lbandedgerrcTaps;
-            filter::FIR<complex_t, complex_t> lbandedgerrc;
-            tap<complex_t> hbandedgerrcTaps;
-            filter::FIR<complex_t, complex_t> hbandedgerrc;
+            //The band-edge filters are complex conjugates of each other (c + jd and c - jd),
+            //so both outputs are built from the two real-tap products P = x*c and Q = x*d
+            tap<float> bandedgeReTaps;
+            tap<float> bandedgeImTaps;
+            complex_t* bandedgeBuf = NULL;
+            complex_t* bandedgeBufStart = NULL;
             float _initFreq;
             double _symbolrate;
             double _samplerate;
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <dsp/processor.h>
+#include <mutex>
+#include <stdexcept>
 
 // #include <osmocom/core/utils.h>
 // #include <osmocom/core/talloc.h>
@@ -10,21 +12,32 @@ extern "C" {
     #include "crypto/tetra_crypto.h"
     #include <phy/tetra_burst.h>
     #include <phy/tetra_burst_sync.h>
+    #include <lower_mac/tetra_rm3014.h>
     #include "c-code/channel.h"
     #include "c-code/source.h"
 }
 
 namespace dsp {
 
+    //The AACH decoder tables are global, every user builds them through this one guard
+    inline void initRm3014() {
+        static std::once_flag rmInit;
+        std::call_once(rmInit, tetra_rm3014_init);
+    }
+
     class osmotetradec : public Processor<uint8_t, float> {
         using base_type = Processor<uint8_t, float>;
     public:
         osmotetradec() {}
         
         ~osmotetradec() {
+            if (!tms) { return; }
+            tetra_mac_state_free(tms);
             free(tms->fragslots);
             free(trs);
             free(tms->t_display_st);
+            tetra_crypto_db_free(tms->tcs->tcdb);
+            free(tms->tcs->tcdb);
             free(tms->tcs);
             free(tms);
             
@@ -56,14 +69,22 @@ namespace dsp {
 // #endif
             tms = (struct tetra_mac_state*)malloc(sizeof(struct tetra_mac_state));
             memset(tms, 0, sizeof(struct tetra_mac_state));
-            tetra_mac_state_init(tms);
+            if (tetra_mac_state_init(tms)) {
+                tetra_mac_state_free(tms);
+                free(tms);
+                tms = NULL;
+                throw std::runtime_error("[osmotetradec] Could not allocate the lower MAC tables");
+            }
             tms->tcs = (struct tetra_crypto_state*)malloc(sizeof(struct tetra_crypto_state));
             memset(tms->tcs, 0, sizeof(struct tetra_crypto_state));
             tms->t_display_st = (struct tetra_display_state*)malloc(sizeof(struct tetra_display_state));
             memset(tms->t_display_st, 0, sizeof(struct tetra_display_state));
-            tetra_crypto_state_init(tms->tcs);
+            //Every instance has its own key database, PHY time and cell data, so decoders don't share any state
+            struct tetra_crypto_database* tcdb = (struct tetra_crypto_database*)malloc(sizeof(struct tetra_crypto_database));
+            memset(tcdb, 0, sizeof(struct tetra_crypto_database));
+            tetra_crypto_state_init(tms->tcs, tcdb);
             trs = (struct tetra_rx_state*)malloc(sizeof(struct tetra_rx_state));
-            memset(trs, 0, sizeof(struct tetra_rx_state));
+            tetra_rx_state_init(trs);
             tms->fragslots = (struct fragslot*)malloc(sizeof(struct fragslot)*FRAGSLOT_NR_SLOTS);
             memset(tms->fragslots, 0, sizeof(struct fragslot)*FRAGSLOT_NR_SLOTS);
 
@@ -72,19 +93,52 @@ namespace dsp {
 
 
             trs->burst_cb_priv = tms;
+            trs->phy_state = &tms->phy_state;
 
             tms->put_voice_data = put_voice_data;
             tms->put_voice_data_ctx = this;
             tms->last_frame = 0;
             tms->curr_active_timeslot = 0;
 
-            Init_Decod_Tetra();
+            //The codec state is global, resetting it here would corrupt the decoders already running
+            static std::once_flag codecInit;
+            std::call_once(codecInit, Init_Decod_Tetra);
+            //Same for the AACH decoder tables
+            initRm3014();
 
             out_tmp_buff.init(32768);
 
             base_type::init(in);
         }
 
+        //Number of msgbs and primitives the MAC had to malloc, stays constant once the pools are warm
+        unsigned long getHeapAllocs() {
+            return tetra_mac_heap_allocs(tms);
+        }
+
+        //Blocks that passed and failed the CRC, type is enum tp_sap_data_type
+        unsigned long getCrcOk(int type) {
+            return (type >= 0 && type < TETRA_BLK_TYPES) ? tms->crc_ok[type] : 0;
+        }
+        unsigned long getCrcFail(int type) {
+            return (type >= 0 && type < TETRA_BLK_TYPES) ? tms->crc_fail[type] : 0;
+        }
+
+        //Work skipped by the decode policy: FEC of blocks and speech frames, and the CPU time that saved
+        unsigned long getFecSkipped() {
+            unsigned long n = 0;
+            for (int i = 0; i < TETRA_BLK_TYPES; i++) {
+                n += tms->decode_stats.fec_skipped[i];
+            }
+            return n;
+        }
+        unsigned long getCodecSkipped() {
+            return tms->decode_stats.codec_skipped;
+        }
+        double getSavedCpuSeconds() {
+            return tetra_decode_saved_ns(tms) * 1e-9;
+        }
+
         //return current RX state. 0=unlocked, 1=know_next_start, 2=locked
         int getRxState() {
             switch(trs->state) {
@@ -97,6 +151,20 @@ namespace dsp {
             }
         }
 
+        //Flywheel statistics
+        int getSyncConfidence() {
+            return trs->confidence;
+        }
+        int getLockLosses() {
+            return trs->lock_losses;
+        }
+        int getRelocks() {
+            return trs->relocks;
+        }
+        int getCoastedBursts() {
+            return trs->coasted_bursts;
+        }
+
         int getCurrHyperframe() {
             return tms->t_display_st->curr_hyperframe;
         }
@@ -106,6 +174,9 @@ namespace dsp {
         int getCurrFrame() {
             return tms->t_display_st->curr_frame;
         }
+        int getCurrTimeslot() { //1..4
+            return tms->phy_state.time.tn;
+        }
         int getTimeslotContent(int ts) { //0-other, 1-NORM1, 2-NORM2, 3-SYNC, 4-VOICE
             return tms->t_display_st->timeslot_content[ts];
         }
@@ -179,9 +250,72 @@ namespace dsp {
             return tms->t_display_st->reg_mandatory;
         }
 
+        //Input is int8_t soft bits from BitUnpacker instead of hard bits
+        void setSoftBits(bool soft) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            softBits = soft;
+            base_type::tempStart();
+        }
+
+        //Bit errors accepted in a burst training sequence before the burst counts as missing
+        void setTrainSeqMaxErrors(int errors) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            trs->max_train_seq_errors = errors;
+            base_type::tempStart();
+        }
+
+        //Bursts without a training sequence the sync keeps its timing through before it drops the lock
+        void setMaxMissedBursts(int bursts) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            trs->max_missed_bursts = bursts;
+            trs->confidence = std::min<unsigned int>(trs->confidence, bursts);
+            base_type::tempStart();
+        }
+
+        //SIMD Viterbi metric kernels, on by default
+        void setSimdViterbi(bool enable) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            osmo_conv_cache_set_simd(&tms->conv_cache, enable);
+            base_type::tempStart();
+        }
+
+        //Hand the coded speech blocks of the active timeslot to 'handler' instead of decoding them, the owner
+        //decodes them with tetra_speech_decode(). The codec state is process-wide: calls are serialized, but
+        //decoders feeding speech at the same time still share the synthesis state, see tetra_speech_decode()
+        void setTrafficHandler(void (*handler)(void* ctx, const int16_t* block), void* ctx) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            trafficHandler = handler;
+            trafficHandlerCtx = ctx;
+            tms->put_traffic_block = handler ? put_traffic_block : NULL;
+            base_type::tempStart();
+        }
+
+        //Timeslots, usage markers and talkgroups whose blocks are decoded, see struct tetra_decode_policy
+        void setDecodePolicy(const struct tetra_decode_policy& policy) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            tms->decode_policy = policy;
+            base_type::tempStart();
+        }
+
         inline int process(int count, const uint8_t* in, float* out)  {
             int outcnt = 0;
-            tetra_burst_sync_in(trs, (uint8_t*)in, count);
+            if(softBits) {
+                tetra_burst_sync_in_soft(trs, (const int8_t*)in, count);
+            } else {
+                tetra_burst_sync_in(trs, (uint8_t*)in, count);
+            }
             if(out_tmp_buff.getReadable(false) > 0) {
                 outcnt += out_tmp_buff.read(out, out_tmp_buff.getReadable(false));
             }
@@ -222,7 +356,15 @@ namespace dsp {
             }
         }
 
+        static void put_traffic_block(void* ctx, const int16_t* block) {
+            osmotetradec* _this = (osmotetradec*) ctx;
+            _this->trafficHandler(_this->trafficHandlerCtx, block);
+        }
+
     private:
+        bool softBits = false;
+        void (*trafficHandler)(void* ctx, const int16_t* block) = NULL;
+        void* trafficHandlerCtx = NULL;
         int inSymsCtr = 0;
         int outSymsCtr = 0;
         void *tetra_tall_ctx = NULL;
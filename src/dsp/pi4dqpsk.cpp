@@ -6,6 +6,7 @@ namespace dsp {
             if (!base_type::_block_init) { return; }
             base_type::stop();
             taps::free(rrcTaps);
+            buffer::free(tileBuf);
         }
 
         void PI4DQPSK::init(stream<complex_t>* in, double symbolrate, double samplerate, int rrcTapCount, double rrcBeta, double agcRate, double costasBandwidth, double fllBandwidth, double omegaGain, double muGain, double omegaRelLimit) {
@@ -26,6 +27,10 @@ namespace dsp {
             costas.out.free();
             recov.out.free();
 
+            if (_tileSize > 0) {
+                tileBuf = buffer::alloc<complex_t>(_tileSize);
+            }
+
             base_type::init(in);
         }
 
@@ -129,14 +134,45 @@ namespace dsp {
             base_type::tempStart();
         }
 
+        void PI4DQPSK::setTileSize(int tileSize) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            _tileSize = std::max<int>(tileSize, 0);
+            buffer::free(tileBuf);
+            tileBuf = (_tileSize > 0) ? buffer::alloc<complex_t>(_tileSize) : NULL;
+            base_type::tempStart();
+        }
+
+        void PI4DQPSK::setFusedTed(bool fused) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            recov.setFusedTed(fused);
+        }
+
         int PI4DQPSK::process(int count, const complex_t* in, complex_t* out) {
-            int ret = count;
-            ret = agc.process(ret, (complex_t*) in, out);
-            ret = fll.process(ret, out, out);
-            ret = rrc.process(ret, out, out);
-            ret = recov.process(ret, out, out);
-            ret = costas.process(ret, out, out);
-            return ret;
+            if (_tileSize <= 0) {
+                int ret = count;
+                ret = agc.process(ret, (complex_t*) in, out);
+                ret = fll.process(ret, out, out);
+                ret = rrc.process(ret, out, out);
+                ret = recov.process(ret, out, out);
+                ret = costas.process(ret, out, out);
+                return ret;
+            }
+
+            // Clock recovery never outputs more symbols than it consumed samples, so writing
+            // out[outCount] can't overwrite input that wasn't processed yet even when in == out
+            int outCount = 0;
+            for (int i = 0; i < count; i += _tileSize) {
+                int ret = std::min<int>(_tileSize, count - i);
+                ret = agc.process(ret, (complex_t*) &in[i], tileBuf);
+                ret = fll.process(ret, tileBuf, tileBuf);
+                ret = rrc.process(ret, tileBuf, tileBuf);
+                ret = recov.process(ret, tileBuf, &out[outCount]);
+                outCount += costas.process(ret, &out[outCount], &out[outCount]);
+            }
+            return outCount;
         }
     }
 }
@@ -22,6 +22,9 @@
 #include "pi4dqpsk_costas.h"
 #include "complex_fd.h"
 
+//Samples per tile in fused mode, 1024 complex samples (8KiB) per stage stay in L1
+#define PI4DQPSK_DEFAULT_TILE_SIZE 1024
+
 namespace dsp {
     namespace demod {
         class PI4DQPSK : public Processor<complex_t, complex_t> {
@@ -64,6 +67,13 @@ namespace dsp {
 
             void reset();
 
+            //Run all stages tile by tile instead of one full pass per stage. 0 = staged reference mode
+            //Both modes produce identical output, every stage keeps its state across calls
+            void setTileSize(int tileSize);
+
+            //Timing error detector evaluates both interpolator banks in one pass, see COMPLEX_FD::setFusedTed
+            void setFusedTed(bool fused);
+
             int process(int count, const complex_t* in, complex_t* out);
 
         protected:
@@ -71,6 +81,8 @@ namespace dsp {
             double _samplerate;
             int _rrcTapCount;
             double _rrcBeta;
+            int _tileSize = PI4DQPSK_DEFAULT_TILE_SIZE;
+            complex_t* tileBuf = NULL;
 
             loop::FLL fll;
             tap<float> rrcTaps;
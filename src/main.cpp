@@ -9,6 +9,7 @@
 #include <module.h>
 // #include <unistd.h>
 #include <fstream>
+#include <algorithm>
 
 #include <dsp/demod/psk.h>
 #include <dsp/buffer/packer.h>
@@ -27,7 +28,11 @@
 #include "dsp/dqpsk_sym_extr.h"
 #include "dsp/pi4dqpsk.h"
 #include "dsp/osmotetra_dec.h"
+#include "netsyms_framer.h"
 #include "gui_widgets.h"
+#ifdef TETRA_CHANNELIZER
+#include "dsp/channelizer.h"
+#endif
 
 
 #define CONCAT(a, b)    ((std::string(a) + b).c_str())
@@ -42,6 +47,8 @@
 #define AGC_RATE 0.02f
 #define COSTAS_LOOP_BANDWIDTH 0.01f
 #define FLL_LOOP_BANDWIDTH 0.006f
+#define CARRIER_SPACING 25000
+#define MAX_CARRIERS 16
 
 SDRPP_MOD_INFO {
     /* Name:            */ "tetra_demodulator",
@@ -66,11 +73,41 @@ public:
             config.conf[name]["port"] = 8355;
             config.conf[name]["sending"] = false;
         }
+        if (!config.conf[name].contains("soft_bits")) {
+            config.conf[name]["soft_bits"] = soft_bits;
+        }
+        if (!config.conf[name].contains("train_seq_errors")) {
+            config.conf[name]["train_seq_errors"] = train_seq_errors;
+        }
+        if (!config.conf[name].contains("max_missed_bursts")) {
+            config.conf[name]["max_missed_bursts"] = max_missed_bursts;
+        }
+        if (!config.conf[name].contains("carriers")) {
+            config.conf[name]["carriers"] = carriers;
+            config.conf[name]["audio_carrier"] = audio_carrier;
+        }
+        if (!config.conf[name].contains("netsyms_v2")) {
+            config.conf[name]["netsyms_v2"] = netsyms_v2;
+            config.conf[name]["netsyms_aligned"] = netsyms_aligned;
+        }
         decoder_mode = config.conf[name]["mode"];
+        soft_bits = config.conf[name]["soft_bits"];
+        train_seq_errors = config.conf[name]["train_seq_errors"];
+        max_missed_bursts = config.conf[name]["max_missed_bursts"];
+        carriers = std::clamp<int>(config.conf[name]["carriers"], 1, MAX_CARRIERS);
+        audio_carrier = config.conf[name]["audio_carrier"];
+        netsyms_v2 = config.conf[name]["netsyms_v2"];
+        netsyms_aligned = config.conf[name]["netsyms_aligned"];
         strcpy(hostname, std::string(config.conf[name]["hostname"]).c_str());
         port = config.conf[name]["port"];
         bool startNow = config.conf[name]["sending"];
         config.release(true);
+#ifndef TETRA_CHANNELIZER
+        if(decoder_mode == 2) {
+            //Multi-carrier mode isn't built in
+            decoder_mode = 0;
+        }
+#endif
 
         vfo = sigpath::vfoManager.createVFO(name, ImGui::WaterfallVFO::REF_CENTER, 0, VFO_BANDWIDTH, VFO_SAMPLERATE, VFO_BANDWIDTH, VFO_BANDWIDTH, true);
 
@@ -78,8 +115,8 @@ public:
         float recov_bandwidth = CLOCK_RECOVERY_BW;
         float recov_dampningFactor = CLOCK_RECOVERY_DAMPN_F;
         float recov_denominator = (1.0f + 2.0*recov_dampningFactor*recov_bandwidth + recov_bandwidth*recov_bandwidth);
-        float recov_mu = (4.0f * recov_dampningFactor * recov_bandwidth) / recov_denominator;
-        float recov_omega = (4.0f * recov_bandwidth * recov_bandwidth) / recov_denominator;
+        recov_mu = (4.0f * recov_dampningFactor * recov_bandwidth) / recov_denominator;
+        recov_omega = (4.0f * recov_bandwidth * recov_bandwidth) / recov_denominator;
 
         mainDemodulator.init(vfo->output, 18000, VFO_SAMPLERATE, RRC_TAP_COUNT, RRC_ALPHA, AGC_RATE, COSTAS_LOOP_BANDWIDTH, FLL_LOOP_BANDWIDTH, recov_omega, recov_mu, CLOCK_RECOVERY_REL_LIM);
         constDiagSplitter.init(&mainDemodulator.out);
@@ -90,9 +127,19 @@ public:
         symbolExtractor.init(&demodStream);
         bitsUnpacker.init(&symbolExtractor.out);
 
+        tetra_train_det_init(&tsDet, 0);
+        for (int i = 0; i < NUM_NETSYMS_SEQS; i++) {
+            tetra_train_det_add(&tsDet, i, netsyms_seqs[i].bits, netsyms_seqs[i].len);
+        }
+        netsymsFramer.init(netsymsInstance(), _netsymsSendHandler, this);
         demodSink.init(&bitsUnpacker.out, _demodSinkHandler, this);
+#ifdef TETRA_CHANNELIZER
+        channelizer.init(vfo->output, carriersSamplerate(), CARRIER_SPACING, VFO_SAMPLERATE);
+#endif
 
         osmotetradecoder.init(&bitsUnpacker.out);
+        osmotetradecoder.setTrainSeqMaxErrors(train_seq_errors);
+        osmotetradecoder.setMaxMissedBursts(max_missed_bursts);
         resamp.init(&osmotetradecoder.out, 8000.0, audioSampleRate);
         outconv.init(&resamp.out);
 
@@ -132,6 +179,9 @@ public:
     void enable() {
         vfo = sigpath::vfoManager.createVFO(name, ImGui::WaterfallVFO::REF_CENTER, 0, 29000, 36000, 29000, 29000, true);
         mainDemodulator.setInput(vfo->output);
+#ifdef TETRA_CHANNELIZER
+        channelizer.setInput(vfo->output);
+#endif
         mainDemodulator.start();
         constDiagSplitter.start();
         constDiagReshaper.start();
@@ -147,6 +197,9 @@ public:
     }
 
     void disable() {
+#ifdef TETRA_CHANNELIZER
+        stopCarriers();
+#endif
         mainDemodulator.stop();
         constDiagSplitter.stop();
         constDiagReshaper.stop();
@@ -181,7 +234,138 @@ private:
         if (conn) { conn->close(); }
     }
 
+#ifdef TETRA_CHANNELIZER
+    //Demodulator and decoder for one channelizer output
+    struct CarrierChain {
+        TetraDemodulatorModule* module;
+        int index;
+        int offset; // in channels from the VFO center
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::PI4DQPSK demod;
+        dsp::DQPSKSymbolExtractor symbolExtractor;
+        dsp::BitUnpacker bitsUnpacker;
+        dsp::osmotetradec decoder;
+        dsp::sink::Handler<float> audioSink;
+    };
+
+    //Twice as many channels as carriers, so the outermost carriers stay clear of the VFO edges
+    double carriersSamplerate() {
+        return 2.0 * carriers * CARRIER_SPACING;
+    }
+
+    void startChannel() {
+        mainDemodulator.start();
+        constDiagSplitter.start();
+        constDiagReshaper.start();
+        constDiagSink.start();
+        symbolExtractor.start();
+        bitsUnpacker.start();
+    }
+
+    void stopChannel() {
+        mainDemodulator.stop();
+        constDiagSplitter.stop();
+        constDiagReshaper.stop();
+        constDiagSink.stop();
+        symbolExtractor.stop();
+        bitsUnpacker.stop();
+        osmotetradecoder.stop();
+        demodSink.stop();
+    }
+
+    void startCarriers() {
+        double bandwidth = carriers * CARRIER_SPACING;
+        vfo->setBandwidthLimits(bandwidth, bandwidth, true);
+        vfo->setSampleRate(carriersSamplerate(), bandwidth);
+        channelizer.setSamplerate(carriersSamplerate());
+        audio_carrier = std::clamp(audio_carrier, 0, carriers - 1);
+
+        for(int i = 0; i < carriers; i++) {
+            CarrierChain* chain = new CarrierChain;
+            chain->module = this;
+            chain->index = i;
+            chain->offset = i - carriers / 2;
+            channelizer.bindChannel(chain->offset, &chain->in);
+            chain->demod.init(&chain->in, 18000, VFO_SAMPLERATE, RRC_TAP_COUNT, RRC_ALPHA, AGC_RATE, COSTAS_LOOP_BANDWIDTH, FLL_LOOP_BANDWIDTH, recov_omega, recov_mu, CLOCK_RECOVERY_REL_LIM);
+            chain->symbolExtractor.init(&chain->demod.out);
+            chain->bitsUnpacker.init(&chain->symbolExtractor.out);
+            chain->decoder.init(&chain->bitsUnpacker.out);
+            chain->symbolExtractor.setSoftBits(soft_bits);
+            chain->bitsUnpacker.setSoftBits(soft_bits);
+            chain->decoder.setSoftBits(soft_bits);
+            chain->decoder.setTrainSeqMaxErrors(train_seq_errors);
+            chain->decoder.setMaxMissedBursts(max_missed_bursts);
+            chain->audioSink.init(&chain->decoder.out, _carrierAudioHandler, chain);
+            carrierChains.emplace_back(chain);
+        }
+
+        resamp.setInput(&carriersAudio);
+        for(auto& chain : carrierChains) {
+            chain->demod.start();
+            chain->symbolExtractor.start();
+            chain->bitsUnpacker.start();
+            chain->decoder.start();
+            chain->audioSink.start();
+        }
+        channelizer.start();
+    }
+
+    void stopCarriers() {
+        if(carrierChains.empty()) {
+            return;
+        }
+        channelizer.stop();
+        for(auto& chain : carrierChains) {
+            chain->demod.stop();
+            chain->symbolExtractor.stop();
+            chain->bitsUnpacker.stop();
+            chain->decoder.stop();
+            chain->audioSink.stop();
+            channelizer.unbindChannel(&chain->in);
+        }
+        carrierChains.clear();
+        resamp.setInput(&osmotetradecoder.out);
+
+        vfo->setBandwidthLimits(VFO_BANDWIDTH, VFO_BANDWIDTH, true);
+        vfo->setSampleRate(VFO_SAMPLERATE, VFO_BANDWIDTH);
+    }
+
+    static void _carrierAudioHandler(float* data, int count, void* ctx) {
+        CarrierChain* chain = (CarrierChain*)ctx;
+        TetraDemodulatorModule* _this = chain->module;
+        //Every decoder always outputs audio, only the selected carrier goes on to the sink
+        if(chain->index != _this->audio_carrier) {
+            return;
+        }
+        std::lock_guard<std::mutex> lck(_this->carriersAudioMtx);
+        memcpy(_this->carriersAudio.writeBuf, data, count * sizeof(float));
+        _this->carriersAudio.swap(count);
+    }
+#endif
+
     void setMode() {
+#ifdef TETRA_CHANNELIZER
+        if(decoder_mode == 2) {
+            //multi-carrier, the single channel chain is idle while the channelizer feeds the carrier chains
+            if(carrierChains.empty()) {
+                stopChannel();
+                startCarriers();
+            }
+            config.acquire();
+            config.conf[name]["mode"] = decoder_mode;
+            config.release(true);
+            return;
+        }
+        if(!carrierChains.empty()) {
+            stopCarriers();
+            startChannel();
+        }
+#endif
+        //Soft bits only go to the built-in decoder, NETSYMS always sends hard symbols
+        bool soft = (decoder_mode == 0) && soft_bits;
+        symbolExtractor.setSoftBits(soft);
+        bitsUnpacker.setSoftBits(soft);
+        osmotetradecoder.setSoftBits(soft);
         if(decoder_mode == 0) {
             //osmo-tetra
             demodSink.stop();
@@ -204,20 +388,29 @@ private:
             style::beginDisabled();
         }
 
-        ImGui::Text("Signal constellation: ");
-        ImGui::SetNextItemWidth(menuWidth);
-        _this->constDiag.draw();
+        //The single channel chain is idle in multi-carrier mode, every carrier shows its own quality below
+        if(_this->decoder_mode != 2) {
+            ImGui::Text("Signal constellation: ");
+            ImGui::SetNextItemWidth(menuWidth);
+            _this->constDiag.draw();
 
-        float avg = 1.0f - _this->symbolExtractor.standarderr;
-        ImGui::Text("Signal quality: ");
-        ImGui::SameLine();
-        ImGui::SigQualityMeter(avg, 0.5f, 1.0f);
-        ImGui::BoxIndicator(ImGui::GetFontSize()*2, _this->symbolExtractor.sync ? IM_COL32(5, 230, 5, 255) : IM_COL32(230, 5, 5, 255));
-        ImGui::SameLine();
-        ImGui::Text(" Sync");
+            float avg = 1.0f - _this->symbolExtractor.standarderr;
+            ImGui::Text("Signal quality: ");
+            ImGui::SameLine();
+            ImGui::SigQualityMeter(avg, 0.5f, 1.0f);
+            ImGui::BoxIndicator(ImGui::GetFontSize()*2, _this->symbolExtractor.sync ? IM_COL32(5, 230, 5, 255) : IM_COL32(230, 5, 5, 255));
+            ImGui::SameLine();
+            ImGui::Text(" Sync");
+            ImGui::SameLine();
+            ImGui::Text(" | SNR: %.1f dB | EVM: %.1f%%", _this->symbolExtractor.snr, _this->symbolExtractor.evm);
+        }
 
         ImGui::BeginGroup();
+#ifdef TETRA_CHANNELIZER
+        ImGui::Columns(3, CONCAT("TetraModeColumns##_", _this->name), false);
+#else
         ImGui::Columns(2, CONCAT("TetraModeColumns##_", _this->name), false);
+#endif
         if (ImGui::RadioButton(CONCAT("OSMO-TETRA##_", _this->name), _this->decoder_mode == 0) && _this->decoder_mode != 0) {
             _this->decoder_mode = 0; //osmo-tetra
             _this->setMode();
@@ -227,15 +420,46 @@ private:
             _this->decoder_mode = 1; //network symbol streaming
             _this->setMode();
         }
+#ifdef TETRA_CHANNELIZER
+        ImGui::NextColumn();
+        if (ImGui::RadioButton(CONCAT("MULTI##_", _this->name), _this->decoder_mode == 2) && _this->decoder_mode != 2) {
+            _this->decoder_mode = 2; //multi-carrier osmo-tetra
+            _this->setMode();
+        }
+#endif
         ImGui::Columns(1, CONCAT("EndTetraModeColumns##_", _this->name), false);
         ImGui::EndGroup();
 
         if(_this->decoder_mode == 0) {
             //OSMO-TETRA
+            if (ImGui::Checkbox(CONCAT("Soft-decision decoding##_tetrademod_soft_", _this->name), &_this->soft_bits)) {
+                config.acquire();
+                config.conf[_this->name]["soft_bits"] = _this->soft_bits;
+                config.release(true);
+                _this->setMode();
+            }
+            ImGui::LeftLabel("Training seq. errors");
+            ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+            if (ImGui::SliderInt(CONCAT("##_tetrademod_tsq_err_", _this->name), &_this->train_seq_errors, 0, 4)) {
+                _this->osmotetradecoder.setTrainSeqMaxErrors(_this->train_seq_errors);
+                config.acquire();
+                config.conf[_this->name]["train_seq_errors"] = _this->train_seq_errors;
+                config.release(true);
+            }
+            ImGui::LeftLabel("Missed bursts");
+            ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+            if (ImGui::SliderInt(CONCAT("##_tetrademod_max_miss_", _this->name), &_this->max_missed_bursts, 0, 72)) {
+                _this->osmotetradecoder.setMaxMissedBursts(_this->max_missed_bursts);
+                config.acquire();
+                config.conf[_this->name]["max_missed_bursts"] = _this->max_missed_bursts;
+                config.release(true);
+            }
             int dec_st = _this->osmotetradecoder.getRxState();
             ImGui::BoxIndicator(ImGui::GetFontSize()*2, (dec_st == 0) ? IM_COL32(230, 5, 5, 255) : ((dec_st == 2) ? IM_COL32(5, 230, 5, 255) : IM_COL32(230, 230, 5, 255)));
             ImGui::SameLine();
             ImGui::Text(" Decoder:  %s", (dec_st == 0) ? "Unlocked" : ((dec_st == 2) ? "Locked" : "Know next start"));
+            ImGui::Text("Lock losses: %d | Relocks: %d | Coasted: %d | Confidence: %d", _this->osmotetradecoder.getLockLosses(), _this->osmotetradecoder.getRelocks(),
+                _this->osmotetradecoder.getCoastedBursts(), _this->osmotetradecoder.getSyncConfidence());
             if(dec_st != 2) {
                 style::beginDisabled();
             }
@@ -326,11 +550,95 @@ private:
             if(dec_st != 2) {
                 style::endDisabled();
             }
+#ifdef TETRA_CHANNELIZER
+        } else if(_this->decoder_mode == 2) {
+            //MULTI-CARRIER
+            ImGui::LeftLabel("Carriers");
+            ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+            if (ImGui::SliderInt(CONCAT("##_tetrademod_carriers_", _this->name), &_this->carriers, 1, MAX_CARRIERS)) {
+                _this->stopCarriers();
+                _this->startCarriers();
+                config.acquire();
+                config.conf[_this->name]["carriers"] = _this->carriers;
+                config.release(true);
+            }
+            ImGui::Text("%d carriers %.0f kHz apart | VFO: %.0f kS/s", _this->carriers, CARRIER_SPACING / 1000.0, _this->carriersSamplerate() / 1000.0);
+            if (ImGui::Checkbox(CONCAT("Soft-decision decoding##_tetrademod_mc_soft_", _this->name), &_this->soft_bits)) {
+                for(auto& chain : _this->carrierChains) {
+                    chain->symbolExtractor.setSoftBits(_this->soft_bits);
+                    chain->bitsUnpacker.setSoftBits(_this->soft_bits);
+                    chain->decoder.setSoftBits(_this->soft_bits);
+                }
+                config.acquire();
+                config.conf[_this->name]["soft_bits"] = _this->soft_bits;
+                config.release(true);
+            }
+            ImGui::LeftLabel("Training seq. errors");
+            ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+            if (ImGui::SliderInt(CONCAT("##_tetrademod_mc_tsq_err_", _this->name), &_this->train_seq_errors, 0, 4)) {
+                for(auto& chain : _this->carrierChains) {
+                    chain->decoder.setTrainSeqMaxErrors(_this->train_seq_errors);
+                }
+                config.acquire();
+                config.conf[_this->name]["train_seq_errors"] = _this->train_seq_errors;
+                config.release(true);
+            }
+            ImGui::LeftLabel("Missed bursts");
+            ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+            if (ImGui::SliderInt(CONCAT("##_tetrademod_mc_max_miss_", _this->name), &_this->max_missed_bursts, 0, 72)) {
+                for(auto& chain : _this->carrierChains) {
+                    chain->decoder.setMaxMissedBursts(_this->max_missed_bursts);
+                }
+                config.acquire();
+                config.conf[_this->name]["max_missed_bursts"] = _this->max_missed_bursts;
+                config.release(true);
+            }
+
+            ImVec4 on_color = ImVec4(0.05, 0.95, 0.05, 1.0);
+            ImVec4 off_color = ImVec4(0.95, 0.05, 0.05, 1.0);
+            ImVec4 value_color = ImVec4(0.95, 0.95, 0.05, 1.0);
+            if (ImGui::BeginTable(CONCAT("##_tetrademod_carriers_tbl_", _this->name), 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Offset");
+                ImGui::TableSetupColumn("SNR");
+                ImGui::TableSetupColumn("Decoder");
+                ImGui::TableSetupColumn("MCC/MNC");
+                ImGui::TableSetupColumn("Audio");
+                ImGui::TableHeadersRow();
+                for(auto& chain : _this->carrierChains) {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%+.1f kHz", chain->offset * CARRIER_SPACING / 1000.0);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::TextColored(chain->symbolExtractor.sync ? on_color : off_color, "%.1f dB", chain->symbolExtractor.snr);
+                    ImGui::TableSetColumnIndex(2);
+                    int dec_st = chain->decoder.getRxState();
+                    ImGui::TextColored((dec_st == 0) ? off_color : ((dec_st == 2) ? on_color : value_color), "%s", (dec_st == 0) ? "Unlocked" : ((dec_st == 2) ? "Locked" : "Know next start"));
+                    ImGui::TableSetColumnIndex(3);
+                    if(dec_st == 2) {
+                        ImGui::TextColored(value_color, "%03d/%03d", chain->decoder.getMcc(), chain->decoder.getMnc());
+                    } else {
+                        ImGui::TextUnformatted("-");
+                    }
+                    ImGui::TableSetColumnIndex(4);
+                    if (ImGui::RadioButton(CONCAT("##_tetrademod_mc_audio_" + std::to_string(chain->index) + "_", _this->name), _this->audio_carrier == chain->index)) {
+                        _this->audio_carrier = chain->index;
+                        config.acquire();
+                        config.conf[_this->name]["audio_carrier"] = _this->audio_carrier;
+                        config.release(true);
+                    }
+                }
+                ImGui::EndTable();
+            }
+#endif
         } else {
             //NETWORK SYM STREAMING
             ImGui::BoxIndicator(menuWidth, _this->tsfound ? IM_COL32(5, 230, 5, 255) : IM_COL32(230, 5, 5, 255));
             ImGui::SameLine();
             ImGui::Text(" Training sequences");
+            if(_this->tsfound && _this->lastTsId >= 0) {
+                ImGui::SameLine();
+                ImGui::Text(" (%s at bit %" PRIu64 ")", netsyms_seqs[_this->lastTsId].name, _this->tsDet.match_bitnum);
+            }
 
             bool netActive = (_this->conn && _this->conn->isOpen());
             if(netActive) { style::beginDisabled(); }
@@ -360,6 +668,20 @@ private:
                 config.release(true);
             }
 
+            if (ImGui::Checkbox(CONCAT("Packed protocol (v2)##_tetrademod_netsyms_v2_", _this->name), &_this->netsyms_v2)) {
+                config.acquire();
+                config.conf[_this->name]["netsyms_v2"] = _this->netsyms_v2;
+                config.release(true);
+            }
+            if(!_this->netsyms_v2) { style::beginDisabled(); }
+            ImGui::SameLine();
+            if (ImGui::Checkbox(CONCAT("Burst aligned##_tetrademod_netsyms_aligned_", _this->name), &_this->netsyms_aligned)) {
+                config.acquire();
+                config.conf[_this->name]["netsyms_aligned"] = _this->netsyms_aligned;
+                config.release(true);
+            }
+            if(!_this->netsyms_v2) { style::endDisabled(); }
+
             ImGui::TextUnformatted("Net status:");
             ImGui::SameLine();
             if (netActive) {
@@ -367,6 +689,11 @@ private:
             } else {
                 ImGui::TextUnformatted("Idle");
             }
+            if (_this->netsyms_v2) {
+                ImGui::SameLine();
+                ImGui::Text(" | Instance: %04x | Seq: %u%s", _this->netsymsInstance(), _this->netsymsFramer.getSeq(),
+                    _this->netsymsFramer.isAlignedActive() ? " | Aligned" : "");
+            }
         }
         if(!_this->enabled) {
             style::endDisabled();
@@ -384,35 +711,44 @@ private:
 
     static void _demodSinkHandler(uint8_t* data, int count, void* ctx) {
         TetraDemodulatorModule* _this = (TetraDemodulatorModule*)ctx;
-        if(_this->conn && _this->conn->isOpen()) {
+        if(!_this->netsyms_v2 && _this->conn && _this->conn->isOpen()) {
             _this->conn->send(data, count);
         }
-        for(int j = 0; j < count; j++) {
-            for(int i = 0; i < 44; i++) {
-                _this->tsfind_buffer[i] = _this->tsfind_buffer[i+1];
-            }
-            _this->tsfind_buffer[44] = data[j];
-            if(!memcmp(_this->tsfind_buffer, training_seq_n, sizeof(training_seq_n)) ||
-                !memcmp(_this->tsfind_buffer, training_seq_p, sizeof(training_seq_p)) ||
-                !memcmp(_this->tsfind_buffer, training_seq_q, sizeof(training_seq_q)) ||
-                !memcmp(_this->tsfind_buffer, training_seq_N, sizeof(training_seq_N)) ||
-                !memcmp(_this->tsfind_buffer, training_seq_P, sizeof(training_seq_P)) ||
-                !memcmp(_this->tsfind_buffer, training_seq_x, sizeof(training_seq_x)) ||
-                !memcmp(_this->tsfind_buffer, training_seq_X, sizeof(training_seq_X)) ||
-                !memcmp(_this->tsfind_buffer, training_seq_y, sizeof(training_seq_y))
-            ) {
+        //The framer always runs so its bit numbers stay in step with the detector
+        _this->netsymsFramer.setAligned(_this->netsyms_aligned);
+        for(int j = 0; j < count;) {
+            int id;
+            int used = tetra_train_det_feed(&_this->tsDet, &data[j], count - j, &id);
+            _this->netsymsFramer.process(&data[j], used);
+            j += used;
+            if(id >= 0) {
                 _this->tsfound = true;
                 _this->symsbeforeexpire = 2048;
-            }
-            if(_this->symsbeforeexpire > 0) {
-                _this->symsbeforeexpire--;
+                _this->lastTsId = id;
+                if(netsyms_seqs[id].burstOffset >= 0) {
+                    _this->netsymsFramer.setBurstStart((int64_t)_this->tsDet.match_bitnum - netsyms_seqs[id].burstOffset);
+                }
+            } else if(_this->symsbeforeexpire > 0) {
+                _this->symsbeforeexpire = std::max(_this->symsbeforeexpire - used, 0);
                 if(_this->symsbeforeexpire == 0) {
                     _this->tsfound = false;
+                    _this->netsymsFramer.setBurstStart(-1);
                 }
             }
         }
     }
 
+    static void _netsymsSendHandler(const uint8_t* data, int len, void* ctx) {
+        TetraDemodulatorModule* _this = (TetraDemodulatorModule*)ctx;
+        if(_this->netsyms_v2 && _this->conn && _this->conn->isOpen()) {
+            _this->conn->send(data, len);
+        }
+    }
+
+    uint16_t netsymsInstance() {
+        return std::hash<std::string>{}(name) & 0xffff;
+    }
+
     static void sampleRateChangeHandler(float sampleRate, void* ctx) {
         TetraDemodulatorModule* _this = (TetraDemodulatorModule*)ctx;
         _this->audioSampleRate = sampleRate;
@@ -442,6 +778,13 @@ private:
 
     dsp::osmotetradec osmotetradecoder;
 
+#ifdef TETRA_CHANNELIZER
+    dsp::multirate::PolyphaseChannelizer channelizer;
+    std::vector<std::unique_ptr<CarrierChain>> carrierChains;
+    dsp::stream<float> carriersAudio;
+    std::mutex carriersAudioMtx;
+#endif
+
     EventHandler<float> srChangeHandler;
     dsp::multirate::RationalResampler<float> resamp;
     dsp::convert::MonoToStereo outconv;
@@ -450,6 +793,14 @@ private:
 
 
     int decoder_mode = 0;
+    bool soft_bits = true;
+    int train_seq_errors = RX_DEF_MAX_TRAIN_SEQ_ERRORS;
+    int max_missed_bursts = RX_DEF_MAX_MISSED_BURSTS;
+    int carriers = 4;
+    int audio_carrier = 0;
+
+    float recov_mu;
+    float recov_omega;
 
 
     //Sequences from osmo-tetra-sq5bpf source
@@ -466,7 +817,29 @@ private:
 
     /* 9.4.4.3.4 Synchronization training sequence */
     static const constexpr uint8_t training_seq_y[38] = { 1,1, 0,0, 0,0, 0,1, 1,0, 0,1, 1,1, 0,0, 1,1, 1,0, 1,0, 0,1, 1,1, 0,0, 0,0, 0,1, 1,0, 0,1, 1,1 };
-    uint8_t tsfind_buffer[45];
+    struct NetsymsSeq {
+        const char* name;
+        const uint8_t* bits;
+        int len;
+        int burstOffset; // position in a downlink burst, -1 if it doesn't tell the burst start
+    };
+    //Sequences the NETSYMS indicator looks for, the id reported by tsDet is the index in here
+    static const constexpr NetsymsSeq netsyms_seqs[] = {
+        { "n", training_seq_n, sizeof(training_seq_n), 244 },
+        { "p", training_seq_p, sizeof(training_seq_p), 244 },
+        { "q", training_seq_q, sizeof(training_seq_q), -1 },
+        { "N", training_seq_N, sizeof(training_seq_N), -1 },
+        { "P", training_seq_P, sizeof(training_seq_P), -1 },
+        { "x", training_seq_x, sizeof(training_seq_x), -1 },
+        { "X", training_seq_X, sizeof(training_seq_X), -1 },
+        { "y", training_seq_y, sizeof(training_seq_y), 214 },
+    };
+    static const constexpr int NUM_NETSYMS_SEQS = sizeof(netsyms_seqs) / sizeof(netsyms_seqs[0]);
+    struct tetra_train_det tsDet;
+    int lastTsId = -1;
+    NetsymsFramer netsymsFramer;
+    bool netsyms_v2 = false;
+    bool netsyms_aligned = true;
     bool tsfound = false;
     int symsbeforeexpire = 0;
 
@@ -0,0 +1,72 @@
+#pragma once
+/* NETSYMS v2 wire format, shared by the module and tools/netsyms_rx.
+ *
+ * Every datagram is NETSYMS_DGRAM_SIZE bytes: a little endian header
+ * followed by a fixed size payload. Bits are packed MSB first, 8 bits
+ * (4 dibit symbols) per byte. Without NETSYMS_FLAG_ALIGNED the payload
+ * holds 'nbits' contiguous bits. With it, every NETSYMS_BLOCK_BYTES block
+ * holds one NETSYMS_BURST_BITS burst starting at the first bit of the
+ * block, 'nbits' is then a multiple of NETSYMS_BURST_BITS. Unused payload
+ * bytes are zero. */
+
+#include <stdint.h>
+
+#define NETSYMS_MAGIC           0x4d595354 // "TSYM"
+#define NETSYMS_VERSION         2
+#define NETSYMS_HEADER_SIZE     24
+#define NETSYMS_BLOCK_BYTES     64
+#define NETSYMS_BLOCKS          8
+#define NETSYMS_PAYLOAD_BYTES   (NETSYMS_BLOCK_BYTES * NETSYMS_BLOCKS)
+#define NETSYMS_PAYLOAD_BITS    (NETSYMS_PAYLOAD_BYTES * 8)
+#define NETSYMS_DGRAM_SIZE      (NETSYMS_HEADER_SIZE + NETSYMS_PAYLOAD_BYTES)
+#define NETSYMS_BURST_BITS      510
+
+//Payload is one burst per block, starting at a burst boundary
+#define NETSYMS_FLAG_ALIGNED    0x01
+
+struct netsyms_header {
+    uint8_t version;
+    uint8_t flags;
+    uint16_t instance;      // sender instance, lets a receiver tell several VFOs apart
+    uint32_t seq;           // +1 per datagram, gaps mean loss
+    uint64_t timestamp;     // bit number of the first payload bit since the sender started
+    uint16_t nbits;         // valid payload bits
+};
+
+static inline void netsyms_put_le(uint8_t* buf, uint64_t val, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        buf[i] = (uint8_t)(val >> (8 * i));
+    }
+}
+
+static inline uint64_t netsyms_get_le(const uint8_t* buf, int bytes) {
+    uint64_t val = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        val = (val << 8) | buf[i];
+    }
+    return val;
+}
+
+static inline void netsyms_put_header(uint8_t* buf, const struct netsyms_header* h) {
+    netsyms_put_le(&buf[0], NETSYMS_MAGIC, 4);
+    buf[4] = h->version;
+    buf[5] = h->flags;
+    netsyms_put_le(&buf[6], h->instance, 2);
+    netsyms_put_le(&buf[8], h->seq, 4);
+    netsyms_put_le(&buf[12], h->timestamp, 8);
+    netsyms_put_le(&buf[20], h->nbits, 2);
+    netsyms_put_le(&buf[22], 0, 2);
+}
+
+//Returns 0 if 'buf' holds a valid v2 datagram
+static inline int netsyms_get_header(const uint8_t* buf, int len, struct netsyms_header* h) {
+    if (len != NETSYMS_DGRAM_SIZE || netsyms_get_le(&buf[0], 4) != NETSYMS_MAGIC) { return -1; }
+    h->version = buf[4];
+    h->flags = buf[5];
+    h->instance = (uint16_t)netsyms_get_le(&buf[6], 2);
+    h->seq = (uint32_t)netsyms_get_le(&buf[8], 4);
+    h->timestamp = netsyms_get_le(&buf[12], 8);
+    h->nbits = (uint16_t)netsyms_get_le(&buf[20], 2);
+    if (h->version != NETSYMS_VERSION || h->nbits > NETSYMS_PAYLOAD_BITS) { return -1; }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "netsyms_framer.h"
+
+#include <string.h>
+
+void NetsymsFramer::init(uint16_t instance, SendHandler handler, void* ctx) {
+    this->instance = instance;
+    this->handler = handler;
+    this->ctx = ctx;
+    bitnum = 0;
+    seq = 0;
+    burstStart = -1;
+    nextBoundary = -1;
+    startDatagram(false);
+}
+
+void NetsymsFramer::setAligned(bool aligned) {
+    this->aligned = aligned;
+    if (aligned && burstStart >= 0 && nextBoundary < 0) {
+        nextBoundary = boundaryFrom(burstStart);
+    }
+}
+
+void NetsymsFramer::setBurstStart(int64_t bitnum) {
+    burstStart = bitnum;
+    //A running boundary is only replaced at its next occurrence, so the current burst stays whole
+    if (aligned && burstStart >= 0 && nextBoundary < 0) {
+        nextBoundary = boundaryFrom(burstStart);
+    }
+}
+
+void NetsymsFramer::process(const uint8_t* bits, int count) {
+    for (int i = 0; i < count; i++) {
+        if ((int64_t)bitnum == nextBoundary) {
+            burstBoundary();
+        }
+        dgram[NETSYMS_HEADER_SIZE + (pos >> 3)] |= (bits[i] & 1) << (7 - (pos & 7));
+        pos++;
+        nbits++;
+        bitnum++;
+        if (pos == NETSYMS_PAYLOAD_BITS) {
+            //Only contiguous datagrams get here, aligned ones end at a burst boundary
+            emit();
+            startDatagram(false);
+        }
+    }
+}
+
+void NetsymsFramer::flush() {
+    emit();
+    startDatagram(alignedActive);
+}
+
+int64_t NetsymsFramer::boundaryFrom(int64_t start) {
+    int64_t next = (int64_t)bitnum - start;
+    next = ((next + NETSYMS_BURST_BITS - 1) / NETSYMS_BURST_BITS) * NETSYMS_BURST_BITS;
+    return start + next;
+}
+
+void NetsymsFramer::burstBoundary() {
+    bool samePhase = aligned && burstStart >= 0 && ((nextBoundary - burstStart) % NETSYMS_BURST_BITS) == 0;
+    if (!samePhase) {
+        //Phase lost or moved: finish the aligned bursts and go on contiguously until the new boundary
+        if (alignedActive) {
+            emit();
+            startDatagram(false);
+        }
+        nextBoundary = (aligned && burstStart >= 0) ? boundaryFrom(burstStart) : -1;
+        if ((int64_t)bitnum == nextBoundary) {
+            burstBoundary();
+        }
+        return;
+    }
+
+    nextBoundary += NETSYMS_BURST_BITS;
+    if (!alignedActive) {
+        emit();
+        startDatagram(true);
+        return;
+    }
+    //Next burst goes to the next block
+    pos = (pos + NETSYMS_BLOCK_BYTES * 8 - 1) / (NETSYMS_BLOCK_BYTES * 8) * (NETSYMS_BLOCK_BYTES * 8);
+    if (pos == NETSYMS_PAYLOAD_BITS) {
+        emit();
+        startDatagram(true);
+    }
+}
+
+void NetsymsFramer::startDatagram(bool aligned) {
+    memset(&dgram[NETSYMS_HEADER_SIZE], 0, NETSYMS_PAYLOAD_BYTES);
+    alignedActive = aligned;
+    nbits = 0;
+    pos = 0;
+    firstBit = bitnum;
+}
+
+void NetsymsFramer::emit() {
+    if (!nbits) { return; }
+    netsyms_header h;
+    h.version = NETSYMS_VERSION;
+    h.flags = alignedActive ? NETSYMS_FLAG_ALIGNED : 0;
+    h.instance = instance;
+    h.seq = seq++;
+    h.timestamp = firstBit;
+    h.nbits = nbits;
+    netsyms_put_header(dgram, &h);
+    if (handler) { handler(dgram, NETSYMS_DGRAM_SIZE, ctx); }
+}
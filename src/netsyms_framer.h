@@ -0,0 +1,54 @@
+#pragma once
+#include "netsyms.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Packs the demodulated bits into fixed size NETSYMS v2 datagrams, see netsyms.h.
+//Bits are coalesced until a datagram is full, so every send carries NETSYMS_PAYLOAD_BITS bits
+class NetsymsFramer {
+public:
+    typedef void (*SendHandler)(const uint8_t* data, int len, void* ctx);
+
+    NetsymsFramer() {}
+
+    void init(uint16_t instance, SendHandler handler, void* ctx);
+
+    //Start datagrams on burst boundaries while the burst phase is known
+    void setAligned(bool aligned);
+
+    //Bit number where some burst started, negative if unknown. Takes effect at the next burst boundary
+    void setBurstStart(int64_t bitnum);
+
+    //Append 'count' bits (one per byte, LSB used), sends every datagram that gets full
+    void process(const uint8_t* bits, int count);
+
+    //Send the partial datagram, if any
+    void flush();
+
+    uint32_t getSeq() { return seq; }
+    uint64_t getBitnum() { return bitnum; }
+    bool isAlignedActive() { return alignedActive; }
+
+private:
+    int64_t boundaryFrom(int64_t start);
+    void burstBoundary();
+    void startDatagram(bool aligned);
+    void emit();
+
+    SendHandler handler = NULL;
+    void* ctx = NULL;
+    uint16_t instance = 0;
+
+    bool aligned = false;
+    int64_t burstStart = -1;
+    int64_t nextBoundary = -1;  // bit number of the next burst start the datagrams follow
+
+    uint8_t dgram[NETSYMS_DGRAM_SIZE];
+    bool alignedActive = false; // current datagram is burst aligned
+    int nbits = 0;              // valid bits in the current datagram
+    int pos = 0;                // next payload bit position
+    uint64_t firstBit = 0;      // bit number of the first payload bit
+    uint64_t bitnum = 0;        // bits seen so far
+    uint32_t seq = 0;
+};
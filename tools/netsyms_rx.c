@@ -0,0 +1,158 @@
+/* Minimal NETSYMS v2 receiver for testing.
+ *
+ * Listens on a UDP port, checks sequence numbers and timestamps of every
+ * sender instance and prints loss statistics to stderr. With -u the bits
+ * are written to stdout unpacked, one bit per byte, which is the format
+ * tetra-rx and the v1 protocol use.
+ *
+ * usage: netsyms_rx [-u] [port]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "netsyms.h"
+
+#define MAX_INSTANCES	16
+
+struct instance_stats {
+	int used;
+	uint16_t instance;
+	uint32_t next_seq;
+	uint64_t next_bit;
+	unsigned long dgrams;
+	unsigned long lost;		/* datagrams missing from the sequence */
+	unsigned long late;		/* duplicated or reordered datagrams */
+	unsigned long bits_gap;		/* bits missing according to the timestamps */
+	unsigned long aligned;
+	unsigned long long bits;
+};
+
+static struct instance_stats stats[MAX_INSTANCES];
+
+static struct instance_stats *get_stats(uint16_t instance)
+{
+	int i;
+
+	for (i = 0; i < MAX_INSTANCES; i++) {
+		if (stats[i].used && stats[i].instance == instance)
+			return &stats[i];
+	}
+	for (i = 0; i < MAX_INSTANCES; i++) {
+		if (!stats[i].used) {
+			memset(&stats[i], 0, sizeof(stats[i]));
+			stats[i].used = 1;
+			stats[i].instance = instance;
+			return &stats[i];
+		}
+	}
+	return NULL;
+}
+
+static void print_stats(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_INSTANCES; i++) {
+		struct instance_stats *st = &stats[i];
+
+		if (!st->used)
+			continue;
+		fprintf(stderr, "instance %04x: %lu dgrams (%lu aligned), %llu bits, %lu lost, %lu late, %lu bits missing\n",
+			st->instance, st->dgrams, st->aligned, st->bits, st->lost, st->late, st->bits_gap);
+	}
+}
+
+/* write the valid payload bits of one datagram to stdout, one per byte */
+static void write_bits(const uint8_t *payload, const struct netsyms_header *h)
+{
+	uint8_t out[NETSYMS_PAYLOAD_BITS];
+	int i, pos;
+
+	for (i = 0; i < h->nbits; i++) {
+		pos = i;
+		if (h->flags & NETSYMS_FLAG_ALIGNED)
+			pos = (i / NETSYMS_BURST_BITS) * NETSYMS_BLOCK_BYTES * 8 + i % NETSYMS_BURST_BITS;
+		out[i] = (payload[pos >> 3] >> (7 - (pos & 7))) & 1;
+	}
+	fwrite(out, 1, h->nbits, stdout);
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t buf[NETSYMS_DGRAM_SIZE + 1];
+	struct sockaddr_in addr;
+	struct netsyms_header h;
+	struct instance_stats *st;
+	time_t last_print = time(NULL);
+	int unpack = 0, port = 8355;
+	int i, fd, len;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-u"))
+			unpack = 1;
+		else
+			port = atoi(argv[i]);
+	}
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("bind");
+		return 1;
+	}
+	fprintf(stderr, "listening on UDP port %d\n", port);
+
+	while ((len = recv(fd, buf, sizeof(buf), 0)) >= 0) {
+		if (netsyms_get_header(buf, len, &h)) {
+			fprintf(stderr, "ignoring %d byte datagram, not NETSYMS v%d\n", len, NETSYMS_VERSION);
+			continue;
+		}
+		st = get_stats(h.instance);
+		if (!st)
+			continue;
+
+		if (st->dgrams && (int32_t)(h.seq - st->next_seq) < 0) {
+			/* already counted as lost, too late to be used */
+			st->late++;
+			continue;
+		}
+		if (st->dgrams) {
+			st->lost += h.seq - st->next_seq;
+			if (h.timestamp > st->next_bit)
+				st->bits_gap += h.timestamp - st->next_bit;
+		}
+		st->next_seq = h.seq + 1;
+		st->next_bit = h.timestamp + h.nbits;
+		st->dgrams++;
+		st->bits += h.nbits;
+		if (h.flags & NETSYMS_FLAG_ALIGNED)
+			st->aligned++;
+
+		if (unpack) {
+			write_bits(&buf[NETSYMS_HEADER_SIZE], &h);
+			fflush(stdout);
+		}
+
+		if (time(NULL) != last_print) {
+			last_print = time(NULL);
+			print_stats();
+		}
+	}
+
+	perror("recv");
+	close(fd);
+	return 1;
+}
@@ -0,0 +1,948 @@
+// Channel impairment simulator and BER/FER benchmark for the demodulator and decoder.
+//
+// usage: tetra_bench [options]
+//   -e list    Eb/N0 points in dB, "from:to:step" or comma separated. Default one point without noise
+//   -o hz      carrier frequency offset, default 0
+//   -p ppm     sample clock error of the receiver, default 0
+//   -n hz      phase noise, 3 dB linewidth of a Wiener process, default 0
+//   -m echo    two ray multipath, "delay_us,gain_db[,phase_deg]"
+//   -d sec     signal length per point, default 20
+//   -S seed    seed of the noise and the generated speech blocks, default 1
+//   -s         soft bits
+//   -t size    demodulator tile size, 0 = staged reference mode
+//   -B bw      clock recovery loop bandwidth, default as in the module
+//   -C bw      Costas loop bandwidth, default as in the module
+//   -L bw      FLL loop bandwidth, default as in the module
+//   --train-errors n
+//              bit errors accepted in a burst training sequence, default as in the module
+//   --max-missed n
+//              bursts without a training sequence the sync coasts through before it drops the lock,
+//              default as in the module
+//   -j file    write the JSON results to a file instead of stdout
+//   -k         run the self-tests and microbenchmarks of the decoder kernels and the FLL instead
+//   -c n       multi-carrier mode, n (1..32) carriers through the polyphase channelizer instead
+//
+// A synthetic downlink from tetra_gen (one traffic slot, SYSINFO every multiframe) goes through the
+// channel and the module's PI4DQPSK -> DQPSKSymbolExtractor -> BitUnpacker -> osmotetradec chain.
+// For every point the results hold the bit error rate of the demodulated bits, the CRC pass rate of
+// the SB1, SB2 and NDB blocks sent after the first lock, the time to lock and to the first decoded
+// cell and the chain throughput in samples/s. Eb/N0 is relative to the direct path, the generator
+// has unit power.
+//
+// Multi-carrier mode runs n generated cells, 25 kHz apart and each with its own colour code, mixed
+// into one wideband signal of 2n channels. The PolyphaseChannelizer splits it again. Every channel
+// is compared with a reference made the single channel way (mix to baseband, prototype lowpass,
+// decimate, resample to 36 kS/s) and decoded through its own chain, which must find its own cell.
+// It fails if a channel differs from the reference by more than CHANNELIZER_NMSE_LIMIT. Eb/N0 and
+// the channel impairments don't apply to it.
+//
+// The demodulated bits are aligned to the sent ones by searching the best offset. Bits before the
+// alignment are not compared, a window with more than 30% errors is taken as a bit slip, dropped from
+// the counts and the alignment is searched again.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "dsp/pi4dqpsk.h"
+#include "dsp/dqpsk_sym_extr.h"
+#include "dsp/bit_unpacker.h"
+#include "dsp/osmotetra_dec.h"
+#include "dsp/channelizer.h"
+
+extern "C" {
+    #include "tetra_gen.h"
+    #include "tetra_pbits.h"
+    #include "lower_mac/crc_simple.h"
+    #include "lower_mac/tetra_rm3014.h"
+}
+
+// Same demodulator parameters as the module
+#define SYMBOL_RATE 18000
+#define SAMPLE_RATE TETRA_GEN_SAMPLE_RATE
+#define CLOCK_RECOVERY_BW 0.00628f
+#define CLOCK_RECOVERY_DAMPN_F 0.707f
+#define CLOCK_RECOVERY_REL_LIM 0.02f
+#define RRC_TAP_COUNT 65
+#define RRC_ALPHA 0.35f
+#define AGC_RATE 0.02f
+#define COSTAS_LOOP_BANDWIDTH 0.01f
+#define FLL_LOOP_BANDWIDTH 0.006f
+
+// Samples per chain call, also the resolution of the lock times (~28ms)
+#define CHUNK_SIZE 1024
+
+// Fractional delay interpolator of the channel
+#define INTERP_TAPS 16
+#define INTERP_PHASES 128
+
+// Bit alignment search
+#define ALIGN_WINDOW 1020
+#define ALIGN_MAX_LAG 2048
+#define ALIGN_MAX_ERRORS (ALIGN_WINDOW / 10)
+#define SLIP_ERRORS (ALIGN_WINDOW * 3 / 10)
+
+// Multi-carrier mode
+#define CARRIER_SPACING 25000
+#define MAX_CARRIERS 32
+#define CHANNELIZER_NMSE_LIMIT -60.0
+
+struct ChannelParams {
+    bool noise = false;
+    double ebn0 = 0;
+    double cfo = 0;
+    double ppm = 0;
+    double linewidth = 0;
+    bool echo = false;
+    double echoDelayUs = 0;
+    double echoGainDb = 0;
+    double echoPhaseDeg = 0;
+};
+
+struct Options {
+    ChannelParams channel;
+    std::vector<double> ebn0;
+    double seconds = 20;
+    uint32_t seed = 1;
+    bool soft = false;
+    int tileSize = PI4DQPSK_DEFAULT_TILE_SIZE;
+    float clockBw = CLOCK_RECOVERY_BW;
+    float costasBw = COSTAS_LOOP_BANDWIDTH;
+    float fllBw = FLL_LOOP_BANDWIDTH;
+    int trainSeqErrors = RX_DEF_MAX_TRAIN_SEQ_ERRORS;
+    int maxMissedBursts = RX_DEF_MAX_MISSED_BURSTS;
+    const char* jsonPath = NULL;
+    bool kernels = false;
+    int carriers = 0;
+};
+
+// Block types with a CRC the generator sends, enum tp_sap_data_type
+static const struct {
+    int type;
+    const char* name;
+} crcTypes[] = {
+    { TPSAP_T_SB1, "SB1" },
+    { TPSAP_T_SB2, "SB2" },
+    { TPSAP_T_NDB, "NDB" },
+};
+#define CRC_TYPE_COUNT 3
+
+static void usage() {
+    fprintf(stderr, "usage: tetra_bench [-e ebn0_list] [-o cfo_hz] [-p ppm] [-n linewidth_hz] [-m delay_us,gain_db[,phase_deg]] [-d sec] [-S seed] [-s] [-t tile] [-B bw] [-C bw] [-L bw] [--train-errors n] [--max-missed n] [-j file] [-k] [-c carriers]\n");
+}
+
+// Average time of one call of 'fn' in ns
+template <typename F>
+static double timeKernel(F fn, int iterations = 200000) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+// The FLL as it was before the shared delay line: both band-edge filters as complex FIR blocks,
+// run one sample at a time. Kept as the reference for the kernel benchmark
+class PerSampleFirFLL : public dsp::loop::FLL {
+public:
+    void init(double bandwidth, int symRate, int sampRate, int filtSize, float filtA) {
+        FLL::init(NULL, bandwidth, symRate, sampRate, filtSize, filtA, 0, -FL_M_PI / 2.0f, FL_M_PI / 2.0f);
+        //Lower band-edge taps are c + jd, the upper ones their conjugate
+        lowerTaps = dsp::taps::alloc<dsp::complex_t>(filtSize);
+        upperTaps = dsp::taps::alloc<dsp::complex_t>(filtSize);
+        for (int i = 0; i < filtSize; i++) {
+            lowerTaps.taps[i] = { bandedgeReTaps.taps[i], bandedgeImTaps.taps[i] };
+            upperTaps.taps[i] = { bandedgeReTaps.taps[i], -bandedgeImTaps.taps[i] };
+        }
+        lower.init(NULL, lowerTaps);
+        upper.init(NULL, upperTaps);
+    }
+
+    ~PerSampleFirFLL() {
+        dsp::taps::free(lowerTaps);
+        dsp::taps::free(upperTaps);
+    }
+
+    int processPerSample(int count, dsp::complex_t* in, dsp::complex_t* out) {
+        for (int i = 0; i < count; i++) {
+            dsp::complex_t shift = dsp::math::phasor(-pcl.phase);
+            dsp::complex_t x = in[i] * shift;
+            dsp::complex_t lbe_out;
+            dsp::complex_t hbe_out;
+            lower.process(1, &x, &lbe_out);
+            upper.process(1, &x, &hbe_out);
+            float freqError = hbe_out.fastAmplitude() - lbe_out.fastAmplitude();
+            pcl.advance(freqError);
+            out[i] = x;
+        }
+        return count;
+    }
+
+private:
+    dsp::tap<dsp::complex_t> lowerTaps;
+    dsp::tap<dsp::complex_t> upperTaps;
+    dsp::filter::FIR<dsp::complex_t, dsp::complex_t> lower;
+    dsp::filter::FIR<dsp::complex_t, dsp::complex_t> upper;
+};
+
+// Both FLL paths on the same generated signal with a frequency offset: they must agree, then their speed
+static int runFllKernel() {
+    struct tetra_gen_cfg cfg;
+    struct tetra_gen gen;
+    tetra_gen_cfg_default(&cfg);
+    tetra_gen_init(&gen, &cfg);
+    uint8_t bits[TETRA_GEN_BURST_BITS];
+    std::vector<float> iq;
+    while (iq.size() < CHUNK_SIZE * 2) {
+        float burst[TETRA_GEN_BURST_SAMPLES * 2];
+        tetra_gen_burst(&gen, bits, NULL);
+        tetra_gen_modulate(&gen, bits, TETRA_GEN_BURST_BITS, burst);
+        iq.insert(iq.end(), burst, burst + TETRA_GEN_BURST_SAMPLES * 2);
+    }
+    dsp::complex_t* in = dsp::buffer::alloc<dsp::complex_t>(CHUNK_SIZE);
+    dsp::complex_t* shared = dsp::buffer::alloc<dsp::complex_t>(CHUNK_SIZE);
+    dsp::complex_t* perSample = dsp::buffer::alloc<dsp::complex_t>(CHUNK_SIZE);
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        float ph = 2.0f * FL_M_PI * 500.0f * i / SAMPLE_RATE;
+        in[i] = dsp::complex_t{ iq[2 * i], iq[2 * i + 1] } * dsp::math::phasor(ph);
+    }
+
+    dsp::loop::FLL fll;
+    fll.init(NULL, FLL_LOOP_BANDWIDTH, SYMBOL_RATE, SAMPLE_RATE, RRC_TAP_COUNT, RRC_ALPHA, 0, -FL_M_PI / 2.0f, FL_M_PI / 2.0f);
+    PerSampleFirFLL ref;
+    ref.init(FLL_LOOP_BANDWIDTH, SYMBOL_RATE, SAMPLE_RATE, RRC_TAP_COUNT, RRC_ALPHA);
+    fll.process(CHUNK_SIZE, in, shared);
+    ref.processPerSample(CHUNK_SIZE, in, perSample);
+    float maxErr = 0;
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        dsp::complex_t d = shared[i] - perSample[i];
+        maxErr = std::max<float>(maxErr, d.amplitude());
+    }
+    if (maxErr > 1e-3f) {
+        fprintf(stderr, "fll: shared delay line differs from the per-sample FIR path by %g\n", maxErr);
+        return 1;
+    }
+    fprintf(stderr, "fll self-test passed (max difference %.1e)\n", maxErr);
+
+    const int iterations = 2000;
+    double perSampleNs = timeKernel([&]() { ref.processPerSample(CHUNK_SIZE, in, perSample); }, iterations) / CHUNK_SIZE;
+    double sharedNs = timeKernel([&]() { fll.process(CHUNK_SIZE, in, shared); }, iterations) / CHUNK_SIZE;
+    printf("fll %d taps, ns per sample (Msps)\n", RRC_TAP_COUNT);
+    printf("  per-sample FIR   %6.1f (%5.2f)\n", perSampleNs, 1e3 / perSampleNs);
+    printf("  shared delay     %6.1f (%5.2f)\n", sharedNs, 1e3 / sharedNs);
+
+    dsp::buffer::free(in);
+    dsp::buffer::free(shared);
+    dsp::buffer::free(perSample);
+    return 0;
+}
+
+// Self-tests of the decoder kernels against their reference versions, then their speed on one block
+static int runKernels() {
+    if (crc16_itut_test()) {
+        fprintf(stderr, "crc16 self-test failed\n");
+        return 1;
+    }
+    fprintf(stderr, "crc16 self-test passed\n");
+    dsp::initRm3014();
+    if (tetra_rm3014_test()) {
+        fprintf(stderr, "rm3014 self-test failed\n");
+        return 1;
+    }
+    fprintf(stderr, "rm3014 self-test passed\n");
+
+    // SCH/F: 268 type-1 bits and the CRC
+    const int len = 284;
+    uint8_t bits[len];
+    uint64_t pbits[PBITS_WORDS(len)];
+    std::mt19937 rng(1);
+    for (int i = 0; i < len; i++) {
+        bits[i] = rng() & 1;
+    }
+    pbits_pack(pbits, bits, len);
+
+    volatile uint16_t sink = 0;
+    printf("crc16 %d bits, ns per block\n", len);
+    printf("  bitwise   %8.1f\n", timeKernel([&]() { sink = crc16_itut_poly(0xffff, 0x1021, bits, len); }));
+    printf("  bits      %8.1f\n", timeKernel([&]() { sink = crc16_itut_bits(0xffff, bits, len); }));
+    printf("  pbits     %8.1f\n", timeKernel([&]() { sink = crc16_itut_pbits(0xffff, pbits, 0, len); }));
+
+    //AACH with two bit errors, one of them on an unreliable bit
+    uint32_t aach = tetra_rm3014_compute(rng() & 0x3fff) ^ 0x00400001;
+    int8_t saach[30];
+    for (int i = 0; i < 30; i++) {
+        saach[i] = ((aach >> (29 - i)) & 1) ? -100 : 100;
+    }
+    saach[29] /= 10;
+    uint16_t info;
+    printf("rm3014 30 bits, ns per block\n");
+    printf("  hard      %8.1f\n", timeKernel([&]() { sink = tetra_rm3014_decode(aach, &info); }));
+    printf("  soft      %8.1f\n", timeKernel([&]() { sink = tetra_rm3014_decode_soft(saach, &info); }));
+    (void)sink;
+    return runFllKernel();
+}
+
+// Applies sample clock error, multipath, phase noise, frequency offset and AWGN to the clean samples
+class Channel {
+public:
+    Channel(const ChannelParams& p, uint32_t seed) : p(p), rng(seed) {
+        //Windowed sinc bank, phase k interpolates k/INTERP_PHASES samples past the integer position
+        for (int k = 0; k < INTERP_PHASES; k++) {
+            float frac = (float)k / INTERP_PHASES;
+            float sum = 0;
+            for (int i = 0; i < INTERP_TAPS; i++) {
+                float x = (float)(i - INTERP_TAPS / 2 + 1) - frac;
+                float sinc = (fabsf(x) < 1e-6f) ? 1.0f : sinf(FL_M_PI * x) / (FL_M_PI * x);
+                float w = 0.42f + 0.5f * cosf(FL_M_PI * x / (INTERP_TAPS / 2)) + 0.08f * cosf(2 * FL_M_PI * x / (INTERP_TAPS / 2));
+                bank[k][i] = sinc * w;
+                sum += bank[k][i];
+            }
+            for (int i = 0; i < INTERP_TAPS; i++) {
+                bank[k][i] /= sum;
+            }
+        }
+        step = 1.0 + p.ppm * 1e-6;
+        echoDelay = p.echoDelayUs * 1e-6 * SAMPLE_RATE;
+        echoGain = powf(10.0f, (float)p.echoGainDb / 20.0f);
+        echoPhase = p.echoPhaseDeg * M_PI / 180.0;
+        pos = INTERP_TAPS + (p.echo ? echoDelay : 0);
+        cfoStep = 2.0 * M_PI * p.cfo / SAMPLE_RATE;
+        pnSigma = sqrt(2.0 * M_PI * p.linewidth / SAMPLE_RATE);
+        //Unit power and 2 bits/symbol: complex noise power fs / (Rs * 2 * Eb/N0)
+        noiseSigma = p.noise ? sqrt((double)SAMPLE_RATE / (SYMBOL_RATE * 2.0 * pow(10.0, p.ebn0 / 10.0)) / 2.0) : 0;
+    }
+
+    void push(const float* iq, int count) {
+        for (int i = 0; i < count; i++) {
+            clean.push_back({ iq[2 * i], iq[2 * i + 1] });
+        }
+    }
+
+    // Clean samples still needed before 'count' outputs can be made
+    bool canPull(int count) {
+        return (pos - base + count * step + INTERP_TAPS) < clean.size();
+    }
+
+    void pull(dsp::complex_t* out, int count) {
+        std::normal_distribution<float> gauss(0.0f, 1.0f);
+        for (int n = 0; n < count; n++) {
+            dsp::complex_t s = interp(pos);
+            if (p.echo) {
+                dsp::complex_t e = interp(pos - echoDelay);
+                float c = echoGain * cosf(echoPhase);
+                float d = echoGain * sinf(echoPhase);
+                s.re += e.re * c - e.im * d;
+                s.im += e.re * d + e.im * c;
+            }
+            float ph = (float)(cfoPhase + pnPhase);
+            float c = cosf(ph), d = sinf(ph);
+            out[n].re = s.re * c - s.im * d + noiseSigma * gauss(rng);
+            out[n].im = s.re * d + s.im * c + noiseSigma * gauss(rng);
+
+            cfoPhase = fmod(cfoPhase + cfoStep, 2.0 * M_PI);
+            if (pnSigma > 0) {
+                pnPhase = fmod(pnPhase + pnSigma * gauss(rng), 2.0 * M_PI);
+            }
+            pos += step;
+        }
+        //Drop what no output can reach anymore
+        uint64_t keep = (uint64_t)(pos - (p.echo ? echoDelay : 0)) - INTERP_TAPS;
+        if (keep > base + 65536) {
+            clean.erase(clean.begin(), clean.begin() + (keep - base));
+            base = keep;
+        }
+    }
+
+private:
+    dsp::complex_t interp(double t) {
+        int64_t i = (int64_t)floor(t);
+        int k = (int)((t - i) * INTERP_PHASES + 0.5);
+        if (k == INTERP_PHASES) { i++; k = 0; }
+        const dsp::complex_t* x = &clean[i - base - INTERP_TAPS / 2 + 1];
+        dsp::complex_t s = { 0, 0 };
+        for (int j = 0; j < INTERP_TAPS; j++) {
+            s.re += x[j].re * bank[k][j];
+            s.im += x[j].im * bank[k][j];
+        }
+        return s;
+    }
+
+    const ChannelParams& p;
+    std::mt19937 rng;
+    float bank[INTERP_PHASES][INTERP_TAPS];
+    std::vector<dsp::complex_t> clean;
+    uint64_t base = 0;      // sample number of clean[0]
+    double pos;             // clean sample time of the next output
+    double step;
+    double echoDelay;
+    float echoGain;
+    float echoPhase;
+    double cfoStep;
+    double cfoPhase = 0;
+    double pnSigma;
+    double pnPhase = 0;
+    float noiseSigma;
+};
+
+// Compares the demodulated bits with the sent ones, see the header
+class BitErrorCounter {
+public:
+    void pushTx(const uint8_t* bits, int count) {
+        tx.insert(tx.end(), bits, bits + count);
+    }
+
+    void pushRx(const uint8_t* bits, int count, bool soft) {
+        for (int i = 0; i < count; i++) {
+            rx.push_back(soft ? ((int8_t)bits[i] < 0) : (bits[i] & 1));
+        }
+        run();
+        trim();
+    }
+
+    uint64_t compared = 0;
+    uint64_t errors = 0;
+    uint64_t skipped = 0;   // received before the alignment was found
+    int slips = 0;
+
+private:
+    void run() {
+        while (rxPos < rxBase + rx.size()) {
+            if (!aligned) {
+                if (!acquire()) { return; }
+                continue;
+            }
+            uint64_t t = rxPos + offset;
+            if (t >= txBase + tx.size()) { return; }
+            uint8_t e = rx[rxPos - rxBase] != tx[t - txBase];
+            windowErrors += e - window[windowPos];
+            window[windowPos] = e;
+            windowPos = (windowPos + 1) % ALIGN_WINDOW;
+            windowBits = std::min(windowBits + 1, ALIGN_WINDOW);
+            errors += e;
+            compared++;
+            rxPos++;
+            if (windowErrors > SLIP_ERRORS) {
+                //Not channel errors, the bits went out of step
+                errors -= windowErrors;
+                compared -= windowBits;
+                slips++;
+                aligned = false;
+            }
+        }
+    }
+
+    // Search the offset of the next ALIGN_WINDOW received bits, false if more bits are needed
+    bool acquire() {
+        if (rxPos + ALIGN_WINDOW > rxBase + rx.size()) { return false; }
+        //The sender is ahead of the receiver, offsets past the sent bits are not possible yet
+        int64_t maxOffset = std::min<int64_t>(ALIGN_MAX_LAG, (int64_t)(txBase + tx.size()) - ALIGN_WINDOW - (int64_t)rxPos);
+        if (maxOffset < -ALIGN_MAX_LAG) { return false; }
+        const uint8_t* r = &rx[rxPos - rxBase];
+        int bestErrors = ALIGN_WINDOW + 1;
+        int64_t bestOffset = 0;
+        for (int64_t off = -ALIGN_MAX_LAG; off <= maxOffset; off++) {
+            int64_t t = (int64_t)rxPos + off;
+            if (t < (int64_t)txBase) { continue; }
+            const uint8_t* s = &tx[t - txBase];
+            int errs = 0;
+            for (int i = 0; i < ALIGN_WINDOW && errs < bestErrors; i++) {
+                errs += r[i] != s[i];
+            }
+            if (errs < bestErrors) {
+                bestErrors = errs;
+                bestOffset = off;
+            }
+        }
+        if (bestErrors > ALIGN_MAX_ERRORS) {
+            rxPos += ALIGN_WINDOW / 2;
+            skipped += ALIGN_WINDOW / 2;
+            return true;
+        }
+        aligned = true;
+        offset = bestOffset;
+        memset(window, 0, sizeof(window));
+        windowErrors = 0;
+        windowBits = 0;
+        windowPos = 0;
+        return true;
+    }
+
+    void trim() {
+        if (rxPos - rxBase > 65536) {
+            rx.erase(rx.begin(), rx.begin() + (rxPos - rxBase));
+            rxBase = rxPos;
+        }
+        int64_t keep = (int64_t)rxPos + (aligned ? offset : 0) - ALIGN_MAX_LAG;
+        if (keep > (int64_t)txBase + 65536) {
+            tx.erase(tx.begin(), tx.begin() + (keep - txBase));
+            txBase = keep;
+        }
+    }
+
+    std::vector<uint8_t> tx, rx;
+    uint64_t txBase = 0, rxBase = 0;
+    uint64_t rxPos = 0;         // next received bit to compare
+    bool aligned = false;
+    int64_t offset = 0;         // received bit n is sent bit n + offset
+    uint8_t window[ALIGN_WINDOW];
+    int windowErrors = 0;
+    int windowBits = 0;
+    int windowPos = 0;
+};
+
+// Demodulator, symbol extractor, unpacker and decoder, driven through process() like in tetra_cli
+class BenchChain {
+public:
+    BenchChain(const Options& opts) {
+        float recov_bandwidth = opts.clockBw;
+        float recov_dampningFactor = CLOCK_RECOVERY_DAMPN_F;
+        float recov_denominator = (1.0f + 2.0*recov_dampningFactor*recov_bandwidth + recov_bandwidth*recov_bandwidth);
+        float recov_mu = (4.0f * recov_dampningFactor * recov_bandwidth) / recov_denominator;
+        float recov_omega = (4.0f * recov_bandwidth * recov_bandwidth) / recov_denominator;
+
+        demod.init(NULL, SYMBOL_RATE, SAMPLE_RATE, RRC_TAP_COUNT, RRC_ALPHA, AGC_RATE, opts.costasBw, opts.fllBw, recov_omega, recov_mu, CLOCK_RECOVERY_REL_LIM);
+        demod.setTileSize(opts.tileSize);
+        symbolExtractor.init(NULL);
+        symbolExtractor.setSoftBits(opts.soft);
+        bitsUnpacker.init(NULL);
+        bitsUnpacker.setSoftBits(opts.soft);
+        decoder.init(NULL);
+        decoder.setSoftBits(opts.soft);
+        decoder.setTrainSeqMaxErrors(opts.trainSeqErrors);
+        decoder.setMaxMissedBursts(opts.maxMissedBursts);
+
+        symBuf = dsp::buffer::alloc<dsp::complex_t>(CHUNK_SIZE);
+        symbols = dsp::buffer::alloc<uint8_t>(CHUNK_SIZE);
+        bits = dsp::buffer::alloc<uint8_t>(CHUNK_SIZE * 8);
+        audioBuf = dsp::buffer::alloc<float>(STREAM_BUFFER_SIZE);
+    }
+
+    ~BenchChain() {
+        dsp::buffer::free(symBuf);
+        dsp::buffer::free(symbols);
+        dsp::buffer::free(bits);
+        dsp::buffer::free(audioBuf);
+    }
+
+    // Run 'count' samples through the chain, returns the number of bits in 'bits'
+    int process(dsp::complex_t* iq, int count) {
+        int nsyms = demod.process(count, iq, symBuf);
+        nsyms = symbolExtractor.process(nsyms, symBuf, symbols);
+        if (nsyms > 0) {
+            snrSum += symbolExtractor.snr;
+            snrCount++;
+        }
+        int nbits = bitsUnpacker.process(nsyms, symbols, bits);
+        decoder.process(nbits, bits, audioBuf);
+        return nbits;
+    }
+
+    dsp::osmotetradec decoder;
+    uint8_t* bits;
+    double snrSum = 0;
+    long snrCount = 0;
+
+private:
+    dsp::demod::PI4DQPSK demod;
+    dsp::DQPSKSymbolExtractor symbolExtractor;
+    dsp::BitUnpacker bitsUnpacker;
+    dsp::complex_t* symBuf;
+    uint8_t* symbols;
+    float* audioBuf;
+};
+
+struct PointResult {
+    ChannelParams channel;
+    uint64_t samples = 0;
+    double elapsed = 0;
+    double lockTime = -1;
+    double cellTime = -1;
+    uint64_t sent[CRC_TYPE_COUNT] = {};
+    uint64_t ok[CRC_TYPE_COUNT] = {};
+    uint64_t fail[CRC_TYPE_COUNT] = {};
+    BitErrorCounter ber;
+    int lockLosses = 0;
+    int relocks = 0;
+    double snr = 0;
+};
+
+static void runPoint(const Options& opts, PointResult& res) {
+    struct tetra_gen_cfg cfg;
+    struct tetra_gen gen;
+    tetra_gen_cfg_default(&cfg);
+    cfg.seed = opts.seed;
+    tetra_gen_init(&gen, &cfg);
+
+    Channel channel(res.channel, opts.seed);
+    BenchChain chain(opts);
+    uint8_t bits[TETRA_GEN_BURST_BITS];
+    float iq[TETRA_GEN_BURST_SAMPLES * 2];
+    dsp::complex_t* buf = dsp::buffer::alloc<dsp::complex_t>(CHUNK_SIZE);
+    //Blocks sent per burst, to count the ones after the first lock
+    std::vector<uint8_t> burstTypes;
+    uint64_t total = (uint64_t)(opts.seconds * SAMPLE_RATE);
+
+    while (res.samples < total) {
+        while (!channel.canPull(CHUNK_SIZE)) {
+            burstTypes.push_back(tetra_gen_burst(&gen, bits, NULL));
+            tetra_gen_modulate(&gen, bits, TETRA_GEN_BURST_BITS, iq);
+            channel.push(iq, TETRA_GEN_BURST_SAMPLES);
+            res.ber.pushTx(bits, TETRA_GEN_BURST_BITS);
+        }
+        channel.pull(buf, CHUNK_SIZE);
+
+        auto start = std::chrono::steady_clock::now();
+        int nbits = chain.process(buf, CHUNK_SIZE);
+        res.elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        res.samples += CHUNK_SIZE;
+        res.ber.pushRx(chain.bits, nbits, opts.soft);
+
+        double t = (double)res.samples / SAMPLE_RATE;
+        if (res.lockTime < 0 && chain.decoder.getRxState() == 2) { res.lockTime = t; }
+        if (res.cellTime < 0 && chain.decoder.getMcc() == cfg.mcc && chain.decoder.getMnc() == cfg.mnc && chain.decoder.getCc() == cfg.colour_code) {
+            res.cellTime = t;
+        }
+    }
+
+    //Sent blocks from the first lock on, received bursts lag the channel input by less than one burst
+    uint64_t lastBurst = total / TETRA_GEN_BURST_SAMPLES;
+    uint64_t firstBurst = (res.lockTime < 0) ? lastBurst : (uint64_t)(res.lockTime * SAMPLE_RATE / TETRA_GEN_BURST_SAMPLES);
+    for (uint64_t i = firstBurst; i < lastBurst && i < burstTypes.size(); i++) {
+        if (burstTypes[i] == TETRA_TRAIN_SYNC) {
+            res.sent[0]++;
+            res.sent[1]++;
+        } else if (burstTypes[i] == TETRA_TRAIN_NORM_2) {
+            res.sent[2] += 2;
+        }
+    }
+    for (int i = 0; i < CRC_TYPE_COUNT; i++) {
+        res.ok[i] = chain.decoder.getCrcOk(crcTypes[i].type);
+        res.fail[i] = chain.decoder.getCrcFail(crcTypes[i].type);
+    }
+    res.lockLosses = chain.decoder.getLockLosses();
+    res.relocks = chain.decoder.getRelocks();
+    res.snr = chain.snrCount ? chain.snrSum / chain.snrCount : 0;
+    dsp::buffer::free(buf);
+}
+
+// One generated cell, resampled to the wideband rate and mixed to its channel
+class CarrierSource {
+public:
+    CarrierSource(const Options& opts, int index, int offset, int channels, double wideRate) : offset(offset), channels(channels) {
+        tetra_gen_cfg_default(&cfg);
+        cfg.seed = opts.seed + index;
+        cfg.colour_code = index + 1;
+        tetra_gen_init(&gen, &cfg);
+        up.init(NULL, SAMPLE_RATE, wideRate);
+        upBuf = dsp::buffer::alloc<dsp::complex_t>((int)(TETRA_GEN_BURST_SAMPLES * wideRate / SAMPLE_RATE) + 16);
+    }
+
+    ~CarrierSource() {
+        dsp::buffer::free(upBuf);
+    }
+
+    // Adds the next 'count' wideband samples to 'out', sample t is mixed by exp(j*2*pi*offset*t/channels)
+    void add(dsp::complex_t* out, int count) {
+        while ((int)pending.size() < count) {
+            uint8_t bits[TETRA_GEN_BURST_BITS];
+            float iq[TETRA_GEN_BURST_SAMPLES * 2];
+            tetra_gen_burst(&gen, bits, NULL);
+            tetra_gen_modulate(&gen, bits, TETRA_GEN_BURST_BITS, iq);
+            int n = up.process(TETRA_GEN_BURST_SAMPLES, (dsp::complex_t*)iq, upBuf);
+            pending.insert(pending.end(), upBuf, upBuf + n);
+        }
+        for (int i = 0; i < count; i++) {
+            int k = (int)(((int64_t)offset * (int64_t)(t + i)) % channels);
+            out[i] = out[i] + pending[i] * dsp::math::phasor(2.0f * FL_M_PI * (float)(k < 0 ? k + channels : k) / channels);
+        }
+        pending.erase(pending.begin(), pending.begin() + count);
+        t += count;
+    }
+
+    struct tetra_gen_cfg cfg;
+
+private:
+    struct tetra_gen gen;
+    dsp::multirate::RationalResampler<dsp::complex_t> up;
+    dsp::complex_t* upBuf;
+    std::vector<dsp::complex_t> pending;
+    int offset;
+    int channels;
+    uint64_t t = 0;
+};
+
+// Single channel reference of the channelizer: mix to baseband, the same prototype lowpass at the wideband
+// rate, keep every M/2th sample and resample to the demodulator rate
+class ReferenceChannel {
+public:
+    ReferenceChannel(int offset, int channels, double wideRate, int maxCount) : offset(offset), channels(channels) {
+        proto = dsp::taps::lowPass(CARRIER_SPACING * 0.6, CARRIER_SPACING * 0.2, wideRate);
+        fir.init(NULL, proto);
+        resamp.init(NULL, 2.0 * CARRIER_SPACING, SAMPLE_RATE);
+        mixBuf = dsp::buffer::alloc<dsp::complex_t>(maxCount);
+        decBuf = dsp::buffer::alloc<dsp::complex_t>(maxCount);
+    }
+
+    ~ReferenceChannel() {
+        dsp::taps::free(proto);
+        dsp::buffer::free(mixBuf);
+        dsp::buffer::free(decBuf);
+    }
+
+    // Same output count as the channelizer gives for the channel
+    int process(int count, const dsp::complex_t* in, dsp::complex_t* out) {
+        for (int i = 0; i < count; i++) {
+            int k = (int)(((int64_t)-offset * (int64_t)(t + i)) % channels);
+            dsp::complex_t x = in[i];
+            mixBuf[i] = x * dsp::math::phasor(2.0f * FL_M_PI * (float)(k < 0 ? k + channels : k) / channels);
+        }
+        fir.process(count, mixBuf, mixBuf);
+        int decim = channels / 2;
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            if ((t + i) % decim == 0) { decBuf[n++] = mixBuf[i]; }
+        }
+        t += count;
+        return resamp.process(n, decBuf, out);
+    }
+
+private:
+    dsp::tap<float> proto;
+    dsp::filter::FIR<dsp::complex_t, float> fir;
+    dsp::multirate::RationalResampler<dsp::complex_t> resamp;
+    dsp::complex_t* mixBuf;
+    dsp::complex_t* decBuf;
+    int offset;
+    int channels;
+    uint64_t t = 0;
+};
+
+// Multi-carrier mode, see the header
+static int runCarriers(const Options& opts) {
+    int carriers = opts.carriers;
+    //Twice as many channels as carriers, so the outermost carriers stay clear of the band edges
+    int channels = 2 * carriers;
+    double wideRate = (double)channels * CARRIER_SPACING;
+    int wideChunk = CHUNK_SIZE * channels;
+    uint64_t total = (uint64_t)(opts.seconds * wideRate);
+
+    dsp::multirate::PolyphaseChannelizer chan;
+    chan.init(NULL, wideRate, CARRIER_SPACING, SAMPLE_RATE);
+    std::vector<std::unique_ptr<CarrierSource>> sources;
+    std::vector<std::unique_ptr<ReferenceChannel>> refs;
+    std::vector<std::unique_ptr<dsp::stream<dsp::complex_t>>> outs;
+    std::vector<std::unique_ptr<BenchChain>> chains;
+    for (int c = 0; c < carriers; c++) {
+        int offset = c - carriers / 2;
+        sources.emplace_back(new CarrierSource(opts, c, offset, channels, wideRate));
+        refs.emplace_back(new ReferenceChannel(offset, channels, wideRate, wideChunk));
+        outs.emplace_back(new dsp::stream<dsp::complex_t>);
+        chan.bindChannel(offset, outs[c].get());
+        chains.emplace_back(new BenchChain(opts));
+    }
+
+    dsp::complex_t* wide = dsp::buffer::alloc<dsp::complex_t>(wideChunk);
+    dsp::complex_t* ref = dsp::buffer::alloc<dsp::complex_t>(wideChunk);
+    std::vector<double> errPow(carriers, 0.0), refPow(carriers, 0.0);
+    double chanTime = 0, refTime = 0;
+    for (uint64_t done = 0; done < total; done += wideChunk) {
+        dsp::buffer::clear(wide, wideChunk);
+        for (auto& src : sources) {
+            src->add(wide, wideChunk);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        chan.process(wideChunk, wide);
+        chanTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (int c = 0; c < carriers; c++) {
+            dsp::complex_t* out = outs[c]->writeBuf;
+            int count = chan.getWritten(outs[c].get());
+            start = std::chrono::steady_clock::now();
+            int refCount = refs[c]->process(wideChunk, wide, ref);
+            refTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (refCount != count) {
+                fprintf(stderr, "channel %d: %d samples from the channelizer, %d from the reference\n", c, count, refCount);
+                return 1;
+            }
+            for (int i = 0; i < count; i++) {
+                dsp::complex_t d = out[i] - ref[i];
+                errPow[c] += (d.re * d.re) + (d.im * d.im);
+                refPow[c] += (ref[i].re * ref[i].re) + (ref[i].im * ref[i].im);
+            }
+            for (int i = 0; i < count; i += CHUNK_SIZE) {
+                chains[c]->process(&out[i], std::min<int>(CHUNK_SIZE, count - i));
+            }
+        }
+    }
+
+    printf("%d carriers at %.0f S/s, %d channels of %d Hz\n", carriers, wideRate, channels, CARRIER_SPACING);
+    int failed = 0;
+    for (int c = 0; c < carriers; c++) {
+        const struct tetra_gen_cfg& cfg = sources[c]->cfg;
+        dsp::osmotetradec& dec = chains[c]->decoder;
+        double nmse = 10.0 * log10(std::max(errPow[c], 1e-30) / std::max(refPow[c], 1e-30));
+        bool cell = dec.getMcc() == cfg.mcc && dec.getMnc() == cfg.mnc && dec.getCc() == cfg.colour_code;
+        printf("  offset %3d: NMSE %7.1f dB, colour code %2d, SB1 %lu ok, NDB %lu ok\n", c - carriers / 2, nmse,
+            dec.getCc(), dec.getCrcOk(TPSAP_T_SB1), dec.getCrcOk(TPSAP_T_NDB));
+        if (nmse > CHANNELIZER_NMSE_LIMIT || !cell) { failed++; }
+    }
+    printf("  channelizer     %6.2f Msps wideband, all channels\n", total / chanTime / 1e6);
+    printf("  per channel     %6.2f Msps wideband, mix + filter + resample of each channel\n", total / refTime / 1e6);
+
+    dsp::buffer::free(wide);
+    dsp::buffer::free(ref);
+    if (failed) {
+        fprintf(stderr, "%d of %d channels differ from the reference or didn't decode their cell\n", failed, carriers);
+        return 1;
+    }
+    return 0;
+}
+
+static void printJsonNumber(FILE* f, double v, bool valid) {
+    if (valid) { fprintf(f, "%.6g", v); }
+    else { fprintf(f, "null"); }
+}
+
+static void writeJson(FILE* f, const Options& opts, const std::vector<std::unique_ptr<PointResult>>& results) {
+    const ChannelParams& c = opts.channel;
+    fprintf(f, "{\n  \"config\": {\"seconds\": %g, \"seed\": %u, \"soft\": %s, \"tile_size\": %d, \"clock_bw\": %g, \"costas_bw\": %g, \"fll_bw\": %g,\n",
+        opts.seconds, opts.seed, opts.soft ? "true" : "false", opts.tileSize, opts.clockBw, opts.costasBw, opts.fllBw);
+    fprintf(f, "    \"train_seq_errors\": %d, \"max_missed_bursts\": %d, \"cfo_hz\": %g, \"clock_ppm\": %g, \"phase_noise_hz\": %g, \"multipath\": ",
+        opts.trainSeqErrors, opts.maxMissedBursts, c.cfo, c.ppm, c.linewidth);
+    if (c.echo) {
+        fprintf(f, "{\"delay_us\": %g, \"gain_db\": %g, \"phase_deg\": %g}},\n", c.echoDelayUs, c.echoGainDb, c.echoPhaseDeg);
+    } else {
+        fprintf(f, "null},\n");
+    }
+    fprintf(f, "  \"points\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const PointResult& r = *results[i];
+        const BitErrorCounter& b = r.ber;
+        fprintf(f, "    {\"ebn0_db\": ");
+        printJsonNumber(f, r.channel.ebn0, r.channel.noise);
+        fprintf(f, ", \"bits\": %llu, \"bit_errors\": %llu, \"bits_skipped\": %llu, \"bit_slips\": %d, \"ber\": ",
+            (unsigned long long)b.compared, (unsigned long long)b.errors, (unsigned long long)b.skipped, b.slips);
+        printJsonNumber(f, b.compared ? (double)b.errors / b.compared : 0, b.compared > 0);
+        fprintf(f, ",\n     \"lock_s\": ");
+        printJsonNumber(f, r.lockTime, r.lockTime >= 0);
+        fprintf(f, ", \"cell_s\": ");
+        printJsonNumber(f, r.cellTime, r.cellTime >= 0);
+        fprintf(f, ", \"lock_losses\": %d, \"relocks\": %d, \"snr_db\": %.2f, \"samples_per_s\": %.0f,\n     \"crc\": {",
+            r.lockLosses, r.relocks, r.snr, r.samples / std::max(r.elapsed, 1e-9));
+        for (int j = 0; j < CRC_TYPE_COUNT; j++) {
+            fprintf(f, "%s\"%s\": {\"sent\": %llu, \"ok\": %llu, \"fail\": %llu, \"pass_rate\": ", j ? ", " : "", crcTypes[j].name,
+                (unsigned long long)r.sent[j], (unsigned long long)r.ok[j], (unsigned long long)r.fail[j]);
+            printJsonNumber(f, r.sent[j] ? std::min(1.0, (double)r.ok[j] / r.sent[j]) : 0, r.sent[j] > 0);
+            fprintf(f, "}");
+        }
+        fprintf(f, "}}%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+static bool parseList(const char* s, std::vector<double>& out) {
+    double from, to, step;
+    if (sscanf(s, "%lf:%lf:%lf", &from, &to, &step) == 3) {
+        if (step <= 0 || to < from) { return false; }
+        for (double v = from; v <= to + step * 1e-6; v += step) {
+            out.push_back(v);
+        }
+        return true;
+    }
+    const char* p = s;
+    while (*p) {
+        char* end;
+        out.push_back(strtod(p, &end));
+        if (end == p) { return false; }
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return !out.empty();
+}
+
+int main(int argc, char** argv) {
+    Options opts;
+    ChannelParams& ch = opts.channel;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasArg = (i + 1 < argc);
+        if (!strcmp(argv[i], "-e") && hasArg) {
+            if (!parseList(argv[++i], opts.ebn0)) { usage(); return 1; }
+        }
+        else if (!strcmp(argv[i], "-o") && hasArg) { ch.cfo = atof(argv[++i]); }
+        else if (!strcmp(argv[i], "-p") && hasArg) { ch.ppm = atof(argv[++i]); }
+        else if (!strcmp(argv[i], "-n") && hasArg) { ch.linewidth = atof(argv[++i]); }
+        else if (!strcmp(argv[i], "-m") && hasArg) {
+            ch.echo = sscanf(argv[++i], "%lf,%lf,%lf", &ch.echoDelayUs, &ch.echoGainDb, &ch.echoPhaseDeg) >= 2;
+            if (!ch.echo || ch.echoDelayUs < 0) { usage(); return 1; }
+        }
+        else if (!strcmp(argv[i], "-d") && hasArg) { opts.seconds = atof(argv[++i]); }
+        else if (!strcmp(argv[i], "-S") && hasArg) { opts.seed = strtoul(argv[++i], NULL, 0); }
+        else if (!strcmp(argv[i], "-s")) { opts.soft = true; }
+        else if (!strcmp(argv[i], "-t") && hasArg) { opts.tileSize = atoi(argv[++i]); }
+        else if (!strcmp(argv[i], "-B") && hasArg) { opts.clockBw = atof(argv[++i]); }
+        else if (!strcmp(argv[i], "-C") && hasArg) { opts.costasBw = atof(argv[++i]); }
+        else if (!strcmp(argv[i], "-L") && hasArg) { opts.fllBw = atof(argv[++i]); }
+        else if (!strcmp(argv[i], "--train-errors") && hasArg) { opts.trainSeqErrors = atoi(argv[++i]); }
+        else if (!strcmp(argv[i], "--max-missed") && hasArg) { opts.maxMissedBursts = atoi(argv[++i]); }
+        else if (!strcmp(argv[i], "-j") && hasArg) { opts.jsonPath = argv[++i]; }
+        else if (!strcmp(argv[i], "-k")) { opts.kernels = true; }
+        else if (!strcmp(argv[i], "-c") && hasArg) {
+            opts.carriers = atoi(argv[++i]);
+            if (opts.carriers < 1 || opts.carriers > MAX_CARRIERS) { usage(); return 1; }
+        }
+        else { usage(); return 1; }
+    }
+    if (opts.seconds <= 0 || opts.trainSeqErrors < 0 || opts.maxMissedBursts < 0) {
+        usage();
+        return 1;
+    }
+    if (opts.kernels) {
+        return runKernels();
+    }
+    if (opts.carriers) {
+        return runCarriers(opts);
+    }
+
+    std::vector<std::unique_ptr<PointResult>> results;
+    int points = opts.ebn0.empty() ? 1 : opts.ebn0.size();
+    for (int i = 0; i < points; i++) {
+        PointResult* r = new PointResult;
+        results.emplace_back(r);
+        r->channel = opts.channel;
+        if (!opts.ebn0.empty()) {
+            r->channel.noise = true;
+            r->channel.ebn0 = opts.ebn0[i];
+        }
+        runPoint(opts, *r);
+
+        const BitErrorCounter& b = r->ber;
+        char label[32];
+        if (r->channel.noise) { snprintf(label, sizeof(label), "Eb/N0 %.1f dB", r->channel.ebn0); }
+        else { snprintf(label, sizeof(label), "no noise"); }
+        fprintf(stderr, "%s: BER %.2e (%llu bits), SB1 %llu/%llu, NDB %llu/%llu, lock %.2f s, %.0f samples/s\n",
+            label, b.compared ? (double)b.errors / b.compared : 0.0, (unsigned long long)b.compared,
+            (unsigned long long)r->ok[0], (unsigned long long)r->sent[0], (unsigned long long)r->ok[2], (unsigned long long)r->sent[2],
+            r->lockTime, r->samples / std::max(r->elapsed, 1e-9));
+    }
+
+    FILE* f = stdout;
+    if (opts.jsonPath) {
+        f = fopen(opts.jsonPath, "w");
+        if (!f) {
+            perror(opts.jsonPath);
+            return 1;
+        }
+    }
+    writeJson(f, opts, results);
+    if (f != stdout) {
+        fclose(f);
+    }
+    return 0;
+}
@@ -0,0 +1,746 @@
+// Headless TETRA decoder: runs the module's signal chain on recorded files, without SDR++, GUI or VFO.
+//
+// usage: tetra_cli [options] input
+//   -f fmt     input format: cf32, cs16 (IQ centered on the carrier), sym (one symbol per byte, as
+//              DQPSKSymbolExtractor outputs), packed (4 symbols per byte, MSB first, as the NETSYMS v2
+//              payload) or bits (one bit per byte, as tetra-rx and NETSYMS v1). Default cf32
+//   -r rate    IQ sample rate, default 36000
+//   -s         soft bits (IQ and sym input)
+//   -a file    write the decoded audio as 8kHz 16-bit WAV
+//   -e file    write events to a file instead of stdout
+//   -t size    demodulator tile size, 0 = staged reference mode
+//   -F         two dot products instead of the fused timing error detector kernel
+//   -V         disable the SIMD Viterbi kernels
+//   -q         no events, only the summary
+//   -j n       batch mode with n worker threads, 0 = one per core. Default 1, streaming mode
+//   -c sec     batch chunk length, default 300
+//   -O sec     batch chunk overlap used to acquire sync, default 5
+//   -T slots   decode only these timeslots, e.g. 13. Default all
+//   -P mode    signalling of the other timeslots: full, crc (FEC and CRC only) or skip. Default skip
+//   -U list    decode only the traffic with these DL usage markers, comma separated
+//   -G list    decode only the traffic of these talkgroups (SSIs), comma separated. Timeslot 1 (MCCH)
+//              is then always decoded, its MAC-RESOURCE PDUs map the talkgroups to usage markers
+//   --train-errors n
+//              bit errors accepted in a burst training sequence, default 2 as in the module
+//   --max-missed n
+//              bursts without a training sequence the sync coasts through before it drops the lock,
+//              default 8 as in the module
+//
+// Input "-" reads stdin in streaming mode. Every event is one line, prefixed with the input time in
+// seconds. The summary on stderr shows the processing speed and the decoder statistics.
+//
+// Batch mode splits a seekable input into chunks that are decoded in parallel. Every chunk starts
+// 'overlap' seconds early and drops what it decodes before its own start, so sync is acquired by
+// then. Events and speech blocks are merged in input order, speech blocks already taken from the
+// previous chunk near the chunk boundary are recognized by their TDMA slot and dropped. The speech
+// codec has global state, so it runs on the main thread while merging.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+#include "dsp/pi4dqpsk.h"
+#include "dsp/dqpsk_sym_extr.h"
+#include "dsp/bit_unpacker.h"
+#include "dsp/osmotetra_dec.h"
+
+// Same demodulator parameters as the module
+#define SYMBOL_RATE 18000
+#define BIT_RATE (2 * SYMBOL_RATE)
+#define CLOCK_RECOVERY_BW 0.00628f
+#define CLOCK_RECOVERY_DAMPN_F 0.707f
+#define CLOCK_RECOVERY_REL_LIM 0.02f
+#define RRC_TAP_COUNT 65
+#define RRC_ALPHA 0.35f
+#define AGC_RATE 0.02f
+#define COSTAS_LOOP_BANDWIDTH 0.01f
+#define FLL_LOOP_BANDWIDTH 0.006f
+
+// Input items per read, also the event time resolution in streaming mode (~57ms of IQ at 36kHz)
+#define CHUNK_SIZE 2048
+// Bits per decoder call in batch mode, the time resolution of events and speech blocks there
+#define BATCH_DECODE_BITS 64
+#define AUDIO_SAMPLERATE 8000
+#define SPEECH_BLOCK_SIZE 432
+#define SPEECH_FRAME_SAMPLES 480
+
+enum InputFormat {
+    INPUT_CF32,
+    INPUT_CS16,
+    INPUT_SYM,
+    INPUT_PACKED,
+    INPUT_BITS
+};
+
+struct Options {
+    InputFormat format = INPUT_CF32;
+    double samplerate = 36000;
+    bool soft = false;
+    bool fusedTed = true;
+    bool simdViterbi = true;
+    int tileSize = PI4DQPSK_DEFAULT_TILE_SIZE;
+    const char* inputPath = NULL;
+    struct tetra_decode_policy policy = {};
+    int trainSeqErrors = RX_DEF_MAX_TRAIN_SEQ_ERRORS;
+    int maxMissedBursts = RX_DEF_MAX_MISSED_BURSTS;
+
+    bool isIQ() const { return format == INPUT_CF32 || format == INPUT_CS16; }
+    int itemSize() const {
+        switch (format) {
+            case INPUT_CF32: return sizeof(dsp::complex_t);
+            case INPUT_CS16: return 2 * sizeof(int16_t);
+            default: return 1;
+        }
+    }
+    double itemRate() const {
+        switch (format) {
+            case INPUT_CF32:
+            case INPUT_CS16: return samplerate;
+            case INPUT_SYM: return SYMBOL_RATE;
+            case INPUT_PACKED: return SYMBOL_RATE / 4;
+            default: return BIT_RATE;
+        }
+    }
+};
+
+// Decoder state the events are generated from
+struct DecoderSnapshot {
+    int rxState = -1;
+    int mcc = -1;
+    int mnc = -1;
+    int cc = -1;
+    int dlFreq = -1;
+    int ulFreq = -1;
+    int tsContent[4] = { -1, -1, -1, -1 };
+    bool encryption = false;
+
+    bool operator==(const DecoderSnapshot& b) const {
+        return rxState == b.rxState && mcc == b.mcc && mnc == b.mnc && cc == b.cc && dlFreq == b.dlFreq && ulFreq == b.ulFreq &&
+            encryption == b.encryption && !memcmp(tsContent, b.tsContent, sizeof(tsContent));
+    }
+    bool operator!=(const DecoderSnapshot& b) const { return !(*this == b); }
+};
+
+static const char* rxStateNames[] = { "unlocked", "know_next_start", "locked" };
+static const char* tsContentNames[] = { "other", "norm1", "norm2", "sync", "voice" };
+
+static void usage() {
+    fprintf(stderr, "usage: tetra_cli [-f cf32|cs16|sym|packed|bits] [-r rate] [-s] [-a audio.wav] [-e events] [-t tile] [-F] [-V] [-q] [-j threads] [-c chunk] [-O overlap] [-T slots] [-P full|crc|skip] [-U markers] [-G talkgroups] [--train-errors n] [--max-missed n] input\n");
+}
+
+// Comma separated numbers, returns the count or -1
+static int parseNumbers(const char* s, uint32_t* out, int max) {
+    int n = 0;
+    while (*s) {
+        char* end;
+        unsigned long v = strtoul(s, &end, 0);
+        if (end == s || n == max) { return -1; }
+        out[n++] = v;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+static void putLe(uint8_t* buf, uint32_t val, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        buf[i] = (uint8_t)(val >> (8 * i));
+    }
+}
+
+static void writeWavHeader(FILE* f, uint32_t samples) {
+    uint8_t h[44];
+    memcpy(&h[0], "RIFF", 4);
+    putLe(&h[4], 36 + samples * 2, 4);
+    memcpy(&h[8], "WAVEfmt ", 8);
+    putLe(&h[16], 16, 4);                   // fmt chunk size
+    putLe(&h[20], 1, 2);                    // PCM
+    putLe(&h[22], 1, 2);                    // mono
+    putLe(&h[24], AUDIO_SAMPLERATE, 4);
+    putLe(&h[28], AUDIO_SAMPLERATE * 2, 4); // byte rate
+    putLe(&h[32], 2, 2);                    // block align
+    putLe(&h[34], 16, 2);                   // bits per sample
+    memcpy(&h[36], "data", 4);
+    putLe(&h[40], samples * 2, 4);
+    fwrite(h, 1, sizeof(h), f);
+}
+
+static DecoderSnapshot takeSnapshot(dsp::osmotetradec& dec) {
+    DecoderSnapshot s;
+    s.rxState = dec.getRxState();
+    s.mcc = dec.getMcc();
+    s.mnc = dec.getMnc();
+    s.cc = dec.getCc();
+    s.dlFreq = dec.getDlFreq();
+    s.ulFreq = dec.getUlFreq();
+    s.encryption = dec.getAirEncryption();
+    for (int i = 0; i < 4; i++) {
+        s.tsContent[i] = dec.getTimeslotContent(i);
+    }
+    return s;
+}
+
+// Print what changed since 'last' and update it
+static void printEvents(FILE* ev, double t, const DecoderSnapshot& cur, DecoderSnapshot& last) {
+    if (cur.rxState != last.rxState) {
+        fprintf(ev, "%.3f rx %s\n", t, rxStateNames[cur.rxState]);
+        last.rxState = cur.rxState;
+    }
+    if (cur.rxState != 2) { return; }
+
+    if (cur.mcc != last.mcc || cur.mnc != last.mnc || cur.cc != last.cc) {
+        fprintf(ev, "%.3f cell mcc %03d mnc %03d cc 0x%02x\n", t, cur.mcc, cur.mnc, cur.cc);
+    }
+    if (cur.dlFreq != last.dlFreq || cur.ulFreq != last.ulFreq) {
+        fprintf(ev, "%.3f freq dl %d ul %d\n", t, cur.dlFreq, cur.ulFreq);
+    }
+    if (cur.encryption != last.encryption) {
+        fprintf(ev, "%.3f encryption %s\n", t, cur.encryption ? "on" : "off");
+    }
+    for (int i = 0; i < 4; i++) {
+        //Only report voice starting and stopping, the other content changes every frame
+        if (cur.tsContent[i] != last.tsContent[i] && (cur.tsContent[i] == 4 || last.tsContent[i] == 4)) {
+            int content = cur.tsContent[i];
+            fprintf(ev, "%.3f ts%d %s\n", t, i + 1, tsContentNames[(content >= 0 && content <= 4) ? content : 0]);
+        }
+    }
+    last = cur;
+}
+
+// Demodulator, symbol extractor, unpacker and decoder for one input stream. The blocks are never
+// started, every stage is driven through process() from the owning thread
+class DecodeChain {
+public:
+    DecodeChain(const Options& opts) : opts(opts) {
+        //Clock recov coeffs
+        float recov_bandwidth = CLOCK_RECOVERY_BW;
+        float recov_dampningFactor = CLOCK_RECOVERY_DAMPN_F;
+        float recov_denominator = (1.0f + 2.0*recov_dampningFactor*recov_bandwidth + recov_bandwidth*recov_bandwidth);
+        float recov_mu = (4.0f * recov_dampningFactor * recov_bandwidth) / recov_denominator;
+        float recov_omega = (4.0f * recov_bandwidth * recov_bandwidth) / recov_denominator;
+
+        demod.init(NULL, SYMBOL_RATE, opts.samplerate, RRC_TAP_COUNT, RRC_ALPHA, AGC_RATE, COSTAS_LOOP_BANDWIDTH, FLL_LOOP_BANDWIDTH, recov_omega, recov_mu, CLOCK_RECOVERY_REL_LIM);
+        demod.setTileSize(opts.tileSize);
+        demod.setFusedTed(opts.fusedTed);
+        symbolExtractor.init(NULL);
+        symbolExtractor.setSoftBits(opts.soft);
+        bitsUnpacker.init(NULL);
+        bitsUnpacker.setSoftBits(opts.soft);
+        decoder.init(NULL);
+        decoder.setSoftBits(opts.soft);
+        decoder.setDecodePolicy(opts.policy);
+        decoder.setTrainSeqMaxErrors(opts.trainSeqErrors);
+        decoder.setMaxMissedBursts(opts.maxMissedBursts);
+        decoder.setSimdViterbi(opts.simdViterbi);
+
+        //Symbols never outnumber the input samples and the decoder output is at most its ring buffer
+        iqBuf = dsp::buffer::alloc<dsp::complex_t>(CHUNK_SIZE);
+        symBuf = dsp::buffer::alloc<dsp::complex_t>(CHUNK_SIZE);
+        symbols = dsp::buffer::alloc<uint8_t>(CHUNK_SIZE);
+        bits = dsp::buffer::alloc<uint8_t>(CHUNK_SIZE * 8);
+        audioBuf = dsp::buffer::alloc<float>(STREAM_BUFFER_SIZE);
+    }
+
+    ~DecodeChain() {
+        dsp::buffer::free(iqBuf);
+        dsp::buffer::free(symBuf);
+        dsp::buffer::free(symbols);
+        dsp::buffer::free(bits);
+        dsp::buffer::free(audioBuf);
+    }
+
+    // Turn up to CHUNK_SIZE input items into decoder input, returns the number of bits in 'bits'
+    int demodulate(const uint8_t* raw, int count) {
+        if (opts.isIQ()) {
+            if (opts.format == INPUT_CF32) {
+                memcpy(iqBuf, raw, count * sizeof(dsp::complex_t));
+            } else {
+                volk_16i_s32f_convert_32f((float*)iqBuf, (const int16_t*)raw, 32768.0f, count * 2);
+            }
+            int nsyms = demod.process(count, iqBuf, symBuf);
+            nsyms = symbolExtractor.process(nsyms, symBuf, symbols);
+            if (nsyms > 0) {
+                snrSum += symbolExtractor.snr;
+                snrCount++;
+            }
+            return bitsUnpacker.process(nsyms, symbols, bits);
+        }
+        if (opts.format == INPUT_SYM) {
+            return bitsUnpacker.process(count, raw, bits);
+        }
+        if (opts.format == INPUT_PACKED) {
+            for (int i = 0; i < count * 8; i++) {
+                bits[i] = (raw[i >> 3] >> (7 - (i & 7))) & 1;
+            }
+            return count * 8;
+        }
+        for (int i = 0; i < count; i++) {
+            bits[i] = raw[i] & 1;
+        }
+        return count;
+    }
+
+    dsp::osmotetradec decoder;
+    uint8_t* bits;
+    float* audioBuf;
+    double snrSum = 0;
+    long snrCount = 0;
+
+private:
+    const Options& opts;
+    dsp::demod::PI4DQPSK demod;
+    dsp::DQPSKSymbolExtractor symbolExtractor;
+    dsp::BitUnpacker bitsUnpacker;
+    dsp::complex_t* iqBuf;
+    dsp::complex_t* symBuf;
+    uint8_t* symbols;
+};
+
+// Totals for the summary
+struct DecodeStats {
+    uint64_t items = 0;
+    uint64_t bits = 0;
+    uint32_t audioSamples = 0;
+    int lockLosses = 0;
+    int relocks = 0;
+    int coasted = 0;
+    unsigned long heapAllocs = 0;
+    unsigned long fecSkipped = 0;
+    unsigned long codecSkipped = 0;
+    double savedCpu = 0;
+    double snrSum = 0;
+    long snrCount = 0;
+
+    void add(DecodeChain& chain) {
+        fecSkipped += chain.decoder.getFecSkipped();
+        codecSkipped += chain.decoder.getCodecSkipped();
+        savedCpu += chain.decoder.getSavedCpuSeconds();
+        lockLosses += chain.decoder.getLockLosses();
+        relocks += chain.decoder.getRelocks();
+        coasted += chain.decoder.getCoastedBursts();
+        heapAllocs += chain.decoder.getHeapAllocs();
+        snrSum += chain.snrSum;
+        snrCount += chain.snrCount;
+    }
+
+    // Totals of one batch chunk
+    void add(const DecodeStats& b) {
+        items += b.items;
+        bits += b.bits;
+        audioSamples += b.audioSamples;
+        lockLosses += b.lockLosses;
+        relocks += b.relocks;
+        coasted += b.coasted;
+        heapAllocs += b.heapAllocs;
+        fecSkipped += b.fecSkipped;
+        codecSkipped += b.codecSkipped;
+        savedCpu += b.savedCpu;
+        snrSum += b.snrSum;
+        snrCount += b.snrCount;
+    }
+};
+
+static void writeAudio(FILE* audio, const float* samples, int count, DecodeStats& stats) {
+    int16_t buf[SPEECH_FRAME_SAMPLES];
+    while (count > 0) {
+        int n = std::min<int>(count, SPEECH_FRAME_SAMPLES);
+        volk_32f_s32f_convert_16i(buf, samples, 32767.0f, n);
+        fwrite(buf, sizeof(int16_t), n, audio);
+        stats.audioSamples += n;
+        samples += n;
+        count -= n;
+    }
+}
+
+static void decodeStreaming(const Options& opts, FILE* in, FILE* ev, FILE* audio, DecodeStats& stats) {
+    DecodeChain chain(opts);
+    DecoderSnapshot last;
+    int itemSize = opts.itemSize();
+    std::vector<uint8_t> raw(CHUNK_SIZE * itemSize);
+
+    while (true) {
+        int count = fread(raw.data(), itemSize, CHUNK_SIZE, in);
+        if (count <= 0) { break; }
+        stats.items += count;
+
+        int nbits = chain.demodulate(raw.data(), count);
+        stats.bits += nbits;
+        int nout = chain.decoder.process(nbits, chain.bits, chain.audioBuf);
+        if (audio && nout > 0) {
+            writeAudio(audio, chain.audioBuf, nout, stats);
+        }
+        if (ev) {
+            printEvents(ev, (double)stats.items / opts.itemRate(), takeSnapshot(chain.decoder), last);
+        }
+    }
+    stats.add(chain);
+}
+
+struct SpeechBlock {
+    double time;
+    int frameKey;   // TDMA slot, to recognize blocks both neighbouring chunks decoded
+    int16_t data[SPEECH_BLOCK_SIZE];
+};
+
+struct StateChange {
+    double time;
+    DecoderSnapshot state;
+};
+
+// Everything one chunk decoded inside its own time range
+struct ChunkResult {
+    std::vector<StateChange> states;
+    std::vector<SpeechBlock> speech;
+    DecodeStats stats;
+    bool done = false;
+};
+
+class BatchDecoder {
+public:
+    BatchDecoder(const Options& opts, uint64_t totalItems, double chunkSeconds, double overlapSeconds) : opts(opts), totalItems(totalItems) {
+        chunkItems = std::max<uint64_t>((uint64_t)(chunkSeconds * opts.itemRate()), CHUNK_SIZE);
+        overlapItems = (uint64_t)(overlapSeconds * opts.itemRate());
+        int chunkCount = (totalItems + chunkItems - 1) / chunkItems;
+        for (int i = 0; i < chunkCount; i++) {
+            results.emplace_back(new ChunkResult);
+        }
+    }
+
+    void run(int threads, FILE* ev, FILE* audio, DecodeStats& stats) {
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back(&BatchDecoder::worker, this, threads);
+        }
+
+        //Merge in chunk order while the workers go on. Both chunks can only claim a block close to
+        //their common boundary, so only the blocks within one overlap of it are compared
+        DecoderSnapshot last;
+        std::vector<int> prevKeys;
+        double window = (double)overlapItems / opts.itemRate();
+        uint64_t audioPos = 0;
+        bool firstSpeech = true;
+        for (int i = 0; i < (int)results.size(); i++) {
+            ChunkResult* res;
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                cv.wait(lck, [&] { return results[i]->done; });
+                res = results[i].get();
+            }
+            if (ev) {
+                for (auto& sc : res->states) {
+                    printEvents(ev, sc.time, sc.state, last);
+                }
+            }
+
+            double chunkStart = (double)(i * chunkItems) / opts.itemRate();
+            double chunkEnd = (double)std::min<uint64_t>((i + 1) * chunkItems, totalItems) / opts.itemRate();
+            std::vector<int> keys;
+            for (auto& sb : res->speech) {
+                if (sb.time < chunkStart + window) {
+                    bool duplicate = false;
+                    for (int k : prevKeys) {
+                        if (k == sb.frameKey) { duplicate = true; }
+                    }
+                    if (duplicate) { continue; }
+                }
+                if (sb.time >= chunkEnd - window) {
+                    keys.push_back(sb.frameKey);
+                }
+
+                int16_t synth[SPEECH_FRAME_SAMPLES];
+                tetra_speech_decode(sb.data, firstSpeech, synth);
+                firstSpeech = false;
+                if (!audio) { continue; }
+                //Voice frames are played back to back, a gap longer than one frame is filled with silence
+                uint64_t pos = (uint64_t)(sb.time * AUDIO_SAMPLERATE);
+                if (pos > audioPos + SPEECH_FRAME_SAMPLES) {
+                    writeSilence(audio, pos - audioPos, stats);
+                    audioPos = pos;
+                }
+                fwrite(synth, sizeof(int16_t), SPEECH_FRAME_SAMPLES, audio);
+                stats.audioSamples += SPEECH_FRAME_SAMPLES;
+                audioPos += SPEECH_FRAME_SAMPLES;
+            }
+            prevKeys = keys;
+
+            stats.add(res->stats);
+
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                results[i].reset();
+                merged = i + 1;
+            }
+            cv.notify_all();
+        }
+        if (audio) {
+            uint64_t end = (uint64_t)((double)totalItems / opts.itemRate() * AUDIO_SAMPLERATE);
+            if (end > audioPos) {
+                writeSilence(audio, end - audioPos, stats);
+            }
+        }
+
+        for (auto& w : workers) {
+            w.join();
+        }
+    }
+
+private:
+    struct WorkerCtx {
+        ChunkResult* res;
+        dsp::osmotetradec* decoder;
+        double time;
+        bool owned;
+    };
+
+    static void writeSilence(FILE* audio, uint64_t count, DecodeStats& stats) {
+        int16_t zeros[SPEECH_FRAME_SAMPLES] = {};
+        while (count > 0) {
+            int n = std::min<uint64_t>(count, SPEECH_FRAME_SAMPLES);
+            fwrite(zeros, sizeof(int16_t), n, audio);
+            stats.audioSamples += n;
+            count -= n;
+        }
+    }
+
+    static void trafficHandler(void* ctx, const int16_t* block) {
+        WorkerCtx* wc = (WorkerCtx*)ctx;
+        if (!wc->owned) { return; }
+        wc->res->speech.emplace_back();
+        SpeechBlock& sb = wc->res->speech.back();
+        sb.time = wc->time;
+        //TDMA time, mn is 1..60, fn 1..18 and tn 1..4
+        int hn = wc->decoder->getCurrHyperframe();
+        int mn = wc->decoder->getCurrMultiframe();
+        int fn = wc->decoder->getCurrFrame();
+        int tn = wc->decoder->getCurrTimeslot();
+        sb.frameKey = ((hn * 60 + mn - 1) * 18 + fn - 1) * 4 + tn - 1;
+        memcpy(sb.data, block, sizeof(sb.data));
+    }
+
+    void worker(int threads) {
+        while (true) {
+            int i = nextChunk++;
+            if (i >= (int)results.size()) { return; }
+            {
+                //Stay close to the merge so finished chunks don't pile up in memory
+                std::unique_lock<std::mutex> lck(mtx);
+                cv.wait(lck, [&] { return i < merged + 2 * threads; });
+            }
+            decodeChunk(i, results[i].get());
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                results[i]->done = true;
+            }
+            cv.notify_all();
+        }
+    }
+
+    void decodeChunk(int idx, ChunkResult* res) {
+        uint64_t ownStart = idx * chunkItems;
+        uint64_t ownEnd = std::min<uint64_t>(ownStart + chunkItems, totalItems);
+        uint64_t start = (ownStart > overlapItems) ? ownStart - overlapItems : 0;
+        double ownStartTime = (double)ownStart / opts.itemRate();
+        int itemSize = opts.itemSize();
+
+        FILE* in = fopen(opts.inputPath, "rb");
+        if (!in || fseeko(in, (off_t)(start * itemSize), SEEK_SET)) {
+            perror(opts.inputPath);
+            exit(1);
+        }
+
+        DecodeChain chain(opts);
+        WorkerCtx wc = { res, &chain.decoder, 0.0, false };
+        chain.decoder.setTrafficHandler(trafficHandler, &wc);
+        DecoderSnapshot last;
+        std::vector<uint8_t> raw(CHUNK_SIZE * itemSize);
+        uint64_t pos = start;
+        uint64_t bitsFed = 0;
+
+        while (pos < ownEnd) {
+            int count = fread(raw.data(), itemSize, std::min<uint64_t>(CHUNK_SIZE, ownEnd - pos), in);
+            if (count <= 0) { break; }
+            pos += count;
+            if (pos > ownStart) {
+                res->stats.items += std::min<uint64_t>(count, pos - ownStart);
+            }
+
+            int nbits = chain.demodulate(raw.data(), count);
+            for (int j = 0; j < nbits; j += BATCH_DECODE_BITS) {
+                int n = std::min<int>(nbits - j, BATCH_DECODE_BITS);
+                bitsFed += n;
+                wc.time = (double)start / opts.itemRate() + (double)bitsFed / BIT_RATE;
+                bool wasOwned = wc.owned;
+                wc.owned = (wc.time >= ownStartTime);
+                chain.decoder.process(n, &chain.bits[j], chain.audioBuf);
+                if (!wc.owned) { continue; }
+
+                res->stats.bits += n;
+                //The first owned state is always recorded, the merge drops it if nothing changed
+                DecoderSnapshot cur = takeSnapshot(chain.decoder);
+                if (!wasOwned || cur != last) {
+                    res->states.push_back({ wc.time, cur });
+                    last = cur;
+                }
+            }
+        }
+        fclose(in);
+        res->stats.add(chain);
+    }
+
+    const Options& opts;
+    uint64_t totalItems;
+    uint64_t chunkItems;
+    uint64_t overlapItems;
+    std::vector<std::unique_ptr<ChunkResult>> results;
+    std::atomic<int> nextChunk { 0 };
+    int merged = 0;
+    std::mutex mtx;
+    std::condition_variable cv;
+};
+
+int main(int argc, char** argv) {
+    Options opts;
+    opts.policy.other_slots = TETRA_DECODE_SKIP;
+    bool quiet = false;
+    int threads = 1;
+    double chunkSeconds = 300;
+    double overlapSeconds = 5;
+    const char* audioPath = NULL;
+    const char* eventsPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasArg = (i + 1 < argc);
+        if (!strcmp(argv[i], "-f") && hasArg) {
+            const char* f = argv[++i];
+            if (!strcmp(f, "cf32")) { opts.format = INPUT_CF32; }
+            else if (!strcmp(f, "cs16")) { opts.format = INPUT_CS16; }
+            else if (!strcmp(f, "sym")) { opts.format = INPUT_SYM; }
+            else if (!strcmp(f, "packed")) { opts.format = INPUT_PACKED; }
+            else if (!strcmp(f, "bits")) { opts.format = INPUT_BITS; }
+            else { usage(); return 1; }
+        }
+        else if (!strcmp(argv[i], "-r") && hasArg) { opts.samplerate = atof(argv[++i]); }
+        else if (!strcmp(argv[i], "-a") && hasArg) { audioPath = argv[++i]; }
+        else if (!strcmp(argv[i], "-e") && hasArg) { eventsPath = argv[++i]; }
+        else if (!strcmp(argv[i], "-t") && hasArg) { opts.tileSize = atoi(argv[++i]); }
+        else if (!strcmp(argv[i], "-j") && hasArg) { threads = atoi(argv[++i]); }
+        else if (!strcmp(argv[i], "-c") && hasArg) { chunkSeconds = atof(argv[++i]); }
+        else if (!strcmp(argv[i], "-O") && hasArg) { overlapSeconds = atof(argv[++i]); }
+        else if (!strcmp(argv[i], "-T") && hasArg) {
+            for (const char* p = argv[++i]; *p; p++) {
+                if (*p < '1' || *p > '4') { usage(); return 1; }
+                opts.policy.timeslots |= 1 << (*p - '1');
+            }
+        }
+        else if (!strcmp(argv[i], "-P") && hasArg) {
+            const char* m = argv[++i];
+            if (!strcmp(m, "full")) { opts.policy.other_slots = TETRA_DECODE_FULL; }
+            else if (!strcmp(m, "crc")) { opts.policy.other_slots = TETRA_DECODE_CRC; }
+            else if (!strcmp(m, "skip")) { opts.policy.other_slots = TETRA_DECODE_SKIP; }
+            else { usage(); return 1; }
+        }
+        else if (!strcmp(argv[i], "-U") && hasArg) {
+            uint32_t markers[64];
+            int n = parseNumbers(argv[++i], markers, 64);
+            if (n <= 0) { usage(); return 1; }
+            for (int k = 0; k < n; k++) {
+                if (markers[k] > 63) { usage(); return 1; }
+                opts.policy.usage_markers |= 1ULL << markers[k];
+            }
+        }
+        else if (!strcmp(argv[i], "-G") && hasArg) {
+            int n = parseNumbers(argv[++i], opts.policy.talkgroups, TETRA_DECODE_MAX_TALKGROUPS);
+            if (n <= 0) { usage(); return 1; }
+            opts.policy.num_talkgroups = n;
+        }
+        else if (!strcmp(argv[i], "--train-errors") && hasArg) { opts.trainSeqErrors = atoi(argv[++i]); }
+        else if (!strcmp(argv[i], "--max-missed") && hasArg) { opts.maxMissedBursts = atoi(argv[++i]); }
+        else if (!strcmp(argv[i], "-s")) { opts.soft = true; }
+        else if (!strcmp(argv[i], "-F")) { opts.fusedTed = false; }
+        else if (!strcmp(argv[i], "-V")) { opts.simdViterbi = false; }
+        else if (!strcmp(argv[i], "-q")) { quiet = true; }
+        else if (argv[i][0] != '-' || !strcmp(argv[i], "-")) { opts.inputPath = argv[i]; }
+        else { usage(); return 1; }
+    }
+    if (!opts.inputPath || opts.samplerate < 2 * SYMBOL_RATE || threads < 0 || chunkSeconds <= 0 || overlapSeconds < 0 || opts.trainSeqErrors < 0 || opts.maxMissedBursts < 0) {
+        usage();
+        return 1;
+    }
+    if (threads == 0) {
+        threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    }
+    //Packed and bit files carry hard decisions only
+    if (opts.format == INPUT_PACKED || opts.format == INPUT_BITS) { opts.soft = false; }
+
+    FILE* in = strcmp(opts.inputPath, "-") ? fopen(opts.inputPath, "rb") : stdin;
+    if (!in) {
+        perror(opts.inputPath);
+        return 1;
+    }
+    uint64_t totalItems = 0;
+    if (threads > 1) {
+        if (in == stdin || fseeko(in, 0, SEEK_END)) {
+            fprintf(stderr, "batch mode needs a seekable input file\n");
+            return 1;
+        }
+        totalItems = ftello(in) / opts.itemSize();
+    }
+    FILE* ev = quiet ? NULL : stdout;
+    if (!quiet && eventsPath) {
+        ev = fopen(eventsPath, "w");
+        if (!ev) {
+            perror(eventsPath);
+            return 1;
+        }
+    }
+    FILE* audio = NULL;
+    if (audioPath) {
+        audio = fopen(audioPath, "wb");
+        if (!audio) {
+            perror(audioPath);
+            return 1;
+        }
+        writeWavHeader(audio, 0);
+    }
+
+    DecodeStats stats;
+    auto start = std::chrono::steady_clock::now();
+    if (threads > 1) {
+        BatchDecoder batch(opts, totalItems, chunkSeconds, overlapSeconds);
+        batch.run(threads, ev, audio, stats);
+    } else {
+        decodeStreaming(opts, in, ev, audio, stats);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double duration = (double)stats.items / opts.itemRate();
+
+    if (audio) {
+        //Fill in the sizes if the output is seekable
+        if (fseek(audio, 0, SEEK_SET) == 0) {
+            writeWavHeader(audio, stats.audioSamples);
+        }
+        fclose(audio);
+    }
+    if (ev && ev != stdout) {
+        fclose(ev);
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+
+    fprintf(stderr, "%.1f s of input in %.2f s (%.1fx realtime), %.0f items/s\n", duration, elapsed, duration / std::max(elapsed, 1e-9), stats.items / std::max(elapsed, 1e-9));
+    fprintf(stderr, "bits: %llu | audio: %u samples | lock losses: %d | relocks: %d | coasted: %d | heap allocs: %lu\n",
+        (unsigned long long)stats.bits, stats.audioSamples, stats.lockLosses, stats.relocks, stats.coasted, stats.heapAllocs);
+    if (stats.snrCount) {
+        fprintf(stderr, "mean SNR: %.1f dB\n", stats.snrSum / stats.snrCount);
+    }
+    fprintf(stderr, "skipped: %lu blocks without FEC | %lu speech frames | ~%.2f s CPU saved\n",
+        stats.fecSkipped, stats.codecSkipped, stats.savedCpu);
+    return 0;
+}
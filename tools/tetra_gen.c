@@ -0,0 +1,207 @@
+/* Synthetic TETRA downlink signal generator.
+ *
+ * Writes the continuous downlink of one cell, see tetra_gen.h, as IQ at
+ * 36 kS/s (cf32 or cs16, interleaved I/Q) or as burst bits, one bit per
+ * byte like tetra-rx and tetra_cli -f bits expect.
+ *
+ * usage: tetra_gen [options] [outfile]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tetra_gen.h>
+
+enum out_format {
+	OUT_CF32,
+	OUT_CS16,
+	OUT_BITS,
+};
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [options] [outfile]\n"
+		"  -m mcc          mobile country code (901)\n"
+		"  -n mnc          mobile network code (9999)\n"
+		"  -c cc           colour code (1)\n"
+		"  -l la           location area (1)\n"
+		"  -f hz           downlink frequency for SYSINFO (420000000)\n"
+		"  -S hex          bs_service_details bits (%03x)\n"
+		"  -H hn           first hyperframe number (1)\n"
+		"  -t slots        traffic timeslots, e.g. 24 or - for none (2)\n"
+		"  -u marker       DL usage marker of the traffic slots, 4..63 (4)\n"
+		"  -v file         coded TCH/S blocks, %d bytes of 0/1 each (pseudo random)\n"
+		"  -r seed         seed of the pseudo random blocks (1)\n"
+		"  -d seconds      length of the output (10)\n"
+		"  -F format       cf32, cs16 or bits (cf32)\n"
+		"outfile defaults to stdout\n",
+		name, TETRA_GEN_SRV_REG | TETRA_GEN_SRV_DEREG | TETRA_GEN_SRV_VOICE |
+		TETRA_GEN_SRV_NORMAL_MODE | TETRA_GEN_SRV_NEVER_MIN_MODE, TETRA_GEN_VOICE_BITS);
+}
+
+static uint8_t *load_voice(const char *path, unsigned int *frames)
+{
+	FILE *f = fopen(path, "rb");
+	uint8_t *buf;
+	long len;
+
+	if (!f) {
+		perror(path);
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	*frames = len / TETRA_GEN_VOICE_BITS;
+	if (!*frames) {
+		fprintf(stderr, "%s: shorter than one %d bit block\n", path, TETRA_GEN_VOICE_BITS);
+		fclose(f);
+		return NULL;
+	}
+	buf = malloc((size_t)*frames * TETRA_GEN_VOICE_BITS);
+	if (!buf || fread(buf, TETRA_GEN_VOICE_BITS, *frames, f) != *frames) {
+		fprintf(stderr, "%s: read failed\n", path);
+		free(buf);
+		fclose(f);
+		return NULL;
+	}
+	fclose(f);
+	for (long i = 0; i < (long)*frames * TETRA_GEN_VOICE_BITS; i++)
+		buf[i] &= 1;
+	return buf;
+}
+
+int main(int argc, char **argv)
+{
+	struct tetra_gen_cfg cfg;
+	struct tetra_gen gen;
+	enum out_format format = OUT_CF32;
+	uint8_t bits[TETRA_GEN_BURST_BITS];
+	float iq[TETRA_GEN_BURST_SAMPLES * 2];
+	int16_t iq16[TETRA_GEN_BURST_SAMPLES * 2];
+	uint8_t *voice = NULL;
+	double seconds = 10;
+	unsigned long bursts, n;
+	FILE *out = stdout;
+	const char *p;
+	int opt, i, marker = 4;
+
+	tetra_gen_cfg_default(&cfg);
+
+	while ((opt = getopt(argc, argv, "m:n:c:l:f:S:H:t:u:v:r:d:F:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			cfg.mcc = atoi(optarg);
+			break;
+		case 'n':
+			cfg.mnc = atoi(optarg);
+			break;
+		case 'c':
+			cfg.colour_code = atoi(optarg);
+			break;
+		case 'l':
+			cfg.la = atoi(optarg);
+			break;
+		case 'f':
+			cfg.dl_freq = strtoul(optarg, NULL, 10);
+			break;
+		case 'S':
+			cfg.service_details = strtoul(optarg, NULL, 16);
+			break;
+		case 'H':
+			cfg.hyperframe = atoi(optarg);
+			break;
+		case 't':
+			cfg.traffic_mask = 0;
+			for (p = optarg; *p; p++) {
+				if (*p >= '1' && *p <= '4')
+					cfg.traffic_mask |= 1 << (*p - '1');
+				else if (*p != '-') {
+					usage(argv[0]);
+					return 1;
+				}
+			}
+			break;
+		case 'u':
+			marker = atoi(optarg);
+			break;
+		case 'v':
+			voice = load_voice(optarg, &cfg.voice_frames);
+			if (!voice)
+				return 1;
+			cfg.voice = voice;
+			break;
+		case 'r':
+			cfg.seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			seconds = atof(optarg);
+			break;
+		case 'F':
+			if (!strcmp(optarg, "cf32"))
+				format = OUT_CF32;
+			else if (!strcmp(optarg, "cs16"))
+				format = OUT_CS16;
+			else if (!strcmp(optarg, "bits"))
+				format = OUT_BITS;
+			else {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	for (i = 0; i < 4; i++)
+		cfg.usage_marker[i] = marker;
+
+	if (tetra_gen_init(&gen, &cfg)) {
+		fprintf(stderr, "invalid cell configuration\n");
+		return 1;
+	}
+	if (optind < argc) {
+		out = fopen(argv[optind], "wb");
+		if (!out) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	bursts = (unsigned long)(seconds * TETRA_GEN_SAMPLE_RATE / TETRA_GEN_BURST_SAMPLES + 0.5);
+	fprintf(stderr, "MCC %u MNC %u CC %u, %lu bursts\n", cfg.mcc, cfg.mnc, cfg.colour_code, bursts);
+
+	for (n = 0; n < bursts; n++) {
+		size_t ok;
+
+		tetra_gen_burst(&gen, bits, NULL);
+		if (format == OUT_BITS) {
+			ok = fwrite(bits, 1, sizeof(bits), out) == sizeof(bits);
+		} else {
+			tetra_gen_modulate(&gen, bits, TETRA_GEN_BURST_BITS, iq);
+			if (format == OUT_CF32) {
+				ok = fwrite(iq, sizeof(iq), 1, out) == 1;
+			} else {
+				/* unit power, leave room for the RRC peaks */
+				for (i = 0; i < TETRA_GEN_BURST_SAMPLES * 2; i++) {
+					float v = iq[i] * 16384.0f;
+					iq16[i] = v > 32767.0f ? 32767 : (v < -32768.0f ? -32768 : (int16_t)v);
+				}
+				ok = fwrite(iq16, sizeof(iq16), 1, out) == 1;
+			}
+		}
+		if (!ok) {
+			perror("write");
+			return 1;
+		}
+	}
+
+	if (out != stdout)
+		fclose(out);
+	free(voice);
+	return 0;
+}